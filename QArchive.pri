@@ -7,6 +7,9 @@ SOURCES +=  $$PWD/src/qarchive_enums.cc \
 	    $$PWD/src/qarchivememoryfile.cc \
 	    $$PWD/src/qarchivememoryextractoroutput.cc \
 	    $$PWD/src/qarchiveioreader_p.cc \
+	    $$PWD/src/qarchiveparallelfilter_p.cc \
+	    $$PWD/src/qarchiveparallelzipwriter_p.cc \
+	    $$PWD/src/qarchivedirectoryscanner_p.cc \
 	    $$PWD/src/qarchiveextractor_p.cc \
 	    $$PWD/src/qarchiveextractor.cc \
 	    $$PWD/src/qarchivecompressor_p.cc \
@@ -21,6 +24,9 @@ HEADERS +=  $$PWD/include/qarchive_enums.hpp \
 	    $$PWD/include/qarchivememoryfile.hpp \
 	    $$PWD/include/qarchivememoryextractoroutput.hpp \
 	    $$PWD/include/qarchiveioreader_p.hpp \
+	    $$PWD/include/qarchiveparallelfilter_p.hpp \
+	    $$PWD/include/qarchiveparallelzipwriter_p.hpp \
+	    $$PWD/include/qarchivedirectoryscanner_p.hpp \
 	    $$PWD/include/qarchiveextractor_p.hpp \
 	    $$PWD/include/qarchiveextractor.hpp \
 	    $$PWD/include/qarchivecompressor_p.hpp \
@@ -39,6 +39,7 @@ enum : short {
   InvalidOutputDirectory,
   InvalidArchiveFile,
   ApplyPatternFailed,
+  ArchiveReadTimeout,
 };
 
 /*
@@ -55,7 +56,8 @@ enum : short {
   NoPermissionToReadFile,
   NoFilesToCompress,
   CannotOpenFile,
-  IODeviceSequential
+  IODeviceSequential,
+  InvalidCompressionOption
 };
 
 /*
@@ -74,5 +76,21 @@ enum formats : short {
   XarFormat,
   ZstdFormat
 };
+
+/*
+ * Extractor format hints, given to setArchiveFormat next to the
+ * formats above. AnyFormat lets libarchive try every format and
+ * filter it supports, AutoFormat picks them from the first bytes
+ * of the archive.
+*/
+enum formatHints : short { AnyFormat = 250, AutoFormat };
+
+/*
+ * Extractor progress modes.
+ * EntryProgress walks the archive once before the extraction to
+ * count the entries and bytes, InputProgress reports the amount of
+ * archive input consumed during the extraction itself.
+*/
+enum progressModes : short { EntryProgress = 300, InputProgress };
 }  // namespace QArchive
 #endif
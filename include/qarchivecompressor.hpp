@@ -26,6 +26,13 @@ class QARCHIVE_EXPORT Compressor : public QObject {
   void setArchiveFormat(short);
   void setPassword(const QString&);
   void setBlockSize(int);
+  void setThreads(int);
+  void setCompressionLevel(int);
+  void setFilterOptions(const QString&);
+  void setProcessEventsInterval(int);
+  void setProgressInterval(int);
+  void setProgressMinimumBytes(qint64);
+  void setProgressPerEntryOnly(bool);
   void addFiles(const QString&, QIODevice*);
   void addFiles(const QStringList&, const QVariantList&);
   void addFiles(const QString&);
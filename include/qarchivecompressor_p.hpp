@@ -9,9 +9,12 @@
 #include <QStringList>
 #include <QVariantList>
 
+#include <atomic>
 #include <deque>
 #include <memory>
 
+#include "qarchivedirectoryscanner_p.hpp"
+#include "qarchiveparallelzipwriter_p.hpp"
 #include "qarchiveutils_p.hpp"
 
 namespace QArchive {
@@ -26,6 +29,13 @@ class CompressorPrivate : public QObject {
   void setArchiveFormat(short);
   void setPassword(const QString&);
   void setBlockSize(int);
+  void setThreads(int);
+  void setCompressionLevel(int);
+  void setFilterOptions(const QString&);
+  void setProcessEventsInterval(int);
+  void setProgressInterval(int);
+  void setProgressMinimumBytes(qint64);
+  void setProgressPerEntryOnly(bool);
   void addFiles(const QString&, QIODevice*);
   void addFiles(const QStringList&, const QVariantList&);
   void addFiles(const QString&);
@@ -43,10 +53,17 @@ class CompressorPrivate : public QObject {
   void pause();
   void resume();
 
+ public:
+  // Thread-safe, seen by a running compression after the current entry.
+  void requestPause();
+  void requestCancel();
+
  private Q_SLOTS:
   bool guessArchiveFormat();
   bool confirmFiles();
   short compress();
+  short compressParallelZip();
+  void reportProgress(const QString&, int, bool);
 
  Q_SIGNALS:
   void progress(QString, int, int, qint64, qint64);
@@ -66,12 +83,18 @@ class CompressorPrivate : public QObject {
     QIODevice* io = nullptr;
     bool valid = false;
     bool isInMemory = false;
+
+    // Gathered once by confirmFiles() for files on the disk.
+    qint64 size = 0;
+    qint64 mtime = 0;
+    quint32 mode = 0;
+    bool isSymLink = false;
   };
 
  private:
   bool b_MemoryMode = false;
-  bool b_PauseRequested = false;
-  bool b_CancelRequested = false;
+  std::atomic<bool> b_PauseRequested{false};
+  std::atomic<bool> b_CancelRequested{false};
   bool b_Paused = false;
   bool b_Started = false;
   bool b_Finished = false;
@@ -79,14 +102,22 @@ class CompressorPrivate : public QObject {
   QString m_Password;        /* Only used for ZIP. */
   short m_ArchiveFormat = 0; /* Defaults to ZIP. */
   int n_BlockSize = 10240;
+  int n_Threads = 1; /* Not used for 7-Zip, tar and xar. */
+  int n_CompressionLevel = -1; /* The default of libarchive. */
+  QString m_FilterOptions;
   int n_TotalEntries = 0;
   qint64 n_BytesProcessed = 0;
   qint64 n_BytesTotal = 0;
   QSharedPointer<struct archive> m_ArchiveWrite;
+  std::unique_ptr<ParallelZipWriter> m_ParallelZip; /* Instead of the above. */
   std::unique_ptr<QSaveFile> m_TemporaryFile;
   std::unique_ptr<QBuffer> m_Buffer;
   std::deque<Node*> m_ConfirmedFiles;
   std::deque<Node*> m_StaggedFiles;
+  EventLoopPump m_EventPump;
+  ProgressThrottle m_ProgressThrottle;
+  QString m_PendingProgressEntry;
+  int n_PendingProcessedEntries = 0;
 };
 }  // namespace QArchive
 #endif  // QARCHIVE_COMPRESSOR_PRIVATE_HPP_INCLUDED
@@ -0,0 +1,64 @@
+#ifndef QARCHIVE_DIRECTORY_SCANNER_PRIVATE_HPP_INCLUDED
+#define QARCHIVE_DIRECTORY_SCANNER_PRIVATE_HPP_INCLUDED
+#include <QString>
+#include <QtGlobal>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace QArchive {
+/* Lists the files below a directory on a pool of threads, each thread
+ * reading whole directories. On Unix a directory is opened once and its
+ * entries are stat'ed relative to its descriptor, so every file costs a
+ * single stat and its size and metadata are kept for later.
+ * Like a breadth-first walk with QDir, the files come out directory by
+ * directory with the files of a directory sorted by name, and only
+ * directories and regular files are looked at, symbolic links being
+ * followed. A link to a directory it is in is not followed, and a directory
+ * reached twice through links is only listed the first time the walk
+ * reaches it, whichever thread read it first. Directories which cannot be
+ * read are skipped. */
+class DirectoryScanner {
+ public:
+  struct File {
+    QString path; /* Relative to the scanned directory. */
+    qint64 size = 0;
+    qint64 mtime = 0;
+    quint32 mode = 0; /* Like st_mode, of the file a link points to. */
+    bool isSymLink = false;
+  };
+
+  explicit DirectoryScanner(int threads);
+
+  Q_DISABLE_COPY(DirectoryScanner)
+
+  std::vector<File> scan(const QString& root);
+
+ private:
+  struct Directory {
+    QString path;
+    QString relativePath; /* Empty or ending with a '/'. */
+    const Directory* parent = nullptr;
+    quint64 device = 0;
+    quint64 inode = 0;
+    bool identified = false; /* Whether device and inode are known. */
+    std::vector<File> files;
+    std::vector<std::unique_ptr<Directory>> children;
+  };
+
+  void run();
+  void read(Directory*);
+
+  int n_Threads = 1;
+
+  std::deque<Directory*> m_Queue;  // Guarded by m_Mutex.
+  int n_Busy = 0;                  // Guarded by m_Mutex.
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+};
+}  // namespace QArchive
+
+#endif  // QARCHIVE_DIRECTORY_SCANNER_PRIVATE_HPP_INCLUDED
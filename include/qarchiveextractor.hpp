@@ -3,10 +3,12 @@
 #include <QBuffer>
 #include <QIODevice>
 #include <QJsonObject>
+#include <QMetaType>
 #include <QObject>
 #include <QString>
 #include <QThread>
 
+#include <functional>
 #include <memory>
 
 #include "qarchive_global.hpp"
@@ -14,6 +16,11 @@
 
 namespace QArchive {
 class ExtractorPrivate;
+
+// Gives the device an entry is extracted to in memory mode, see
+// setEntryDeviceFactory.
+using EntryDeviceFactory = std::function<QIODevice*(const QJsonObject&)>;
+
 class QARCHIVE_EXPORT Extractor : public QObject {
   Q_OBJECT
  public:
@@ -27,6 +34,7 @@ class QARCHIVE_EXPORT Extractor : public QObject {
   void setArchive(const QString&, const QString&);
   void setBlockSize(int);
   void setCalculateProgress(bool);
+  void setProgressMode(short);
   void setOutputDirectory(const QString&);
   void setPassword(const QString&);
   void addFilter(const QString&);
@@ -38,11 +46,26 @@ class QARCHIVE_EXPORT Extractor : public QObject {
   void setBasePath(const QString&);
   void setRawMode(bool);
   void setRawOutputFilename(const QString&);
+  void setIndexCacheDirectory(const QString&);
+  void setThreads(int);
+  void setProcessEventsInterval(int);
+  void setProgressInterval(int);
+  void setProgressMinimumBytes(qint64);
+  void setProgressPerEntryOnly(bool);
+  void setEntryDeviceFactory(const EntryDeviceFactory&);
+  void setDropPageCache(bool);
+  void setReadAhead(int);
+  void setFollowTimeout(int);
+  void setSequentialTimeout(int);
+  void setBlockCache(int);
+  void setArchiveFormat(short);
   void clear();
 
   void getInfo();
 
   void start();
+  void extractEntry(const QString&);
+  void extractEntries(const QStringList&);
   void cancel();
   void pause();
   void resume();
@@ -59,10 +82,12 @@ class QARCHIVE_EXPORT Extractor : public QObject {
   void getInfoRequirePassword(int);
   void extractionRequirePassword(int);
   void info(QJsonObject);
+  void statistics(QJsonObject);
 
  private:
   std::unique_ptr<ExtractorPrivate> m_Extractor;
   std::unique_ptr<QThread> m_Thread;
 };
 }  // namespace QArchive
+Q_DECLARE_METATYPE(QArchive::EntryDeviceFactory)
 #endif  // QARCHIVE_EXTRACTOR_HPP_INCLUDED
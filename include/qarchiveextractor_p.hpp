@@ -1,24 +1,34 @@
 #ifndef QARCHIVE_EXTRACTOR_PRIVATE_HPP_INCLUDED
 #define QARCHIVE_EXTRACTOR_PRIVATE_HPP_INCLUDED
 #include <QBuffer>
+#include <QByteArray>
 #include <QDir>
 #include <QEventLoop>
 #include <QIODevice>
 #include <QJsonObject>
 #include <QObject>
+#include <QSet>
 #include <QSharedPointer>
 #include <QString>
 #include <QStringList>
 #include <QVector>
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
+#include "qarchive_enums.hpp"
+#include "qarchiveextractor.hpp"
+#include "qarchiveioreader_p.hpp"
 #include "qarchivememoryextractoroutput.hpp"
+#include "qarchiveparallelfilter_p.hpp"
 #include "qarchiveutils_p.hpp"
 
 namespace QArchive {
 
 class ArchiveFilter;
+class EntryPathRewriter;
+class ExtractFilter;
 
 class MutableMemoryFile {
  public:
@@ -44,6 +54,7 @@ class ExtractorPrivate : public QObject {
   void setArchive(const QString&);
   void setBlockSize(int);
   void setCalculateProgress(bool);
+  void setProgressMode(short);
   void setOutputDirectory(const QString&);
   void setPassword(const QString&);
   void addFilter(const QString&);
@@ -55,22 +66,54 @@ class ExtractorPrivate : public QObject {
   void setBasePath(const QString&);
   void setRawMode(bool);
   void setRawOutputFilename(const QString&);
+  void setIndexCacheDirectory(const QString&);
+  void setThreads(int);
+  void setProcessEventsInterval(int);
+  void setProgressInterval(int);
+  void setProgressMinimumBytes(qint64);
+  void setProgressPerEntryOnly(bool);
+  void setEntryDeviceFactory(EntryDeviceFactory);
+  void setDropPageCache(bool);
+  void setReadAhead(int);
+  void setFollowTimeout(int);
+  void setSequentialTimeout(int);
+  void setBlockCache(int);
+  void setArchiveFormat(short);
   void clear();
 
   void getInfo();
 
   void start();
+  void extractEntry(const QString&);
+  void extractEntries(const QStringList&);
   void cancel();
   void pause();
   void resume();
 
+ public:
+  // Thread-safe, seen by a running extraction on its next block.
+  void requestPause();
+  void requestCancel();
+
  private Q_SLOTS:
   short openArchive();
   short checkOutputDirectory();
   short getTotalEntriesCount();
   short processArchiveInformation();
+  bool loadIndexCache();
+  void saveIndexCache();
+  void buildInfoFromIndex();
+  qint64 indexedStartPosition() const;
   short writeData(struct archive_entry*);
+  short writeDataToDevice(struct archive_entry*, const QJsonObject&);
+  short readError(struct archive*);
   short extract();
+  short extractParallel(bool*);
+  bool isEntryExtracted(struct archive_entry*);
+  void clearExtractEntries();
+  void reportProgress(const char*, bool, bool force = false);
+  void flushProgress();
+  void emitStatistics();
   void toggleArchiveFormat(struct archive*);
 
  Q_SIGNALS:
@@ -82,6 +125,7 @@ class ExtractorPrivate : public QObject {
   void memoryFinished(MemoryExtractorOutput*);
   void error(short);
   void info(QJsonObject);
+  void statistics(QJsonObject);
   void progress(QString, int, int, qint64, qint64);
   void getInfoRequirePassword(int);
   void extractionRequirePassword(int);
@@ -91,39 +135,87 @@ class ExtractorPrivate : public QObject {
   bool b_RawMode = false;
   bool b_ProcessingArchive = false;
   bool b_StartRequested = false;
+  bool b_ExtractEntriesOnly = false;
+  bool b_DropPageCache = false;
+  int n_ReadAheadBlocks = 0;
+  int n_FollowTimeout = 0;
+  int n_SequentialTimeout = 30000;
+  int n_CacheBlocks = 0;
+  short n_ArchiveFormat = AnyFormat;
+  short n_DetectedFormat = 0;  // Set once AutoFormat looked at the archive.
 
-  bool b_PauseRequested = false;
-  bool b_CancelRequested = false;
+  std::atomic<bool> b_PauseRequested{false};
+  std::atomic<bool> b_CancelRequested{false};
   bool b_Paused = false;
   bool b_Started = false;
   bool b_Finished = false;
   bool b_NoProgress = true;
   bool b_ArchiveOpened = false;
+  bool b_SequentialConsumed = false;  // Set once getInfo() read it through.
+  bool b_FollowedToEnd = false;  // Set once a followed archive ended.
   bool b_QIODeviceOwned = false;  // If set, free m_Archive on clear()
   int n_PasswordTriedCountGetInfo = 0;
   int n_PasswordTriedCountExtract = 0;
   int n_ProcessedEntries = 0;
   int n_TotalEntries = -1;
-  int n_BlockSize = 10240;
+  int n_BlockSize = 0;  // 0 picks it from the archive device.
   int n_Flags = 0;
+  int n_Threads = 1;
+  int n_DecompressionThreads = 1;  // Of the last extraction.
+  short m_ProgressMode = EntryProgress;
   qint64 n_BytesProcessed = 0;
   qint64 n_BytesTotal = 0;
+  qint64 n_InputBytesTotal = 0;
 
   QString m_OutputDirectory;
   QString m_Password;
   QString m_ArchivePath;
   QString m_RawOutputFilename;
+  QString m_IndexCacheDirectory;
   QIODevice* m_Archive = nullptr;
   archive_entry* m_CurrentArchiveEntry = nullptr;
   MutableMemoryFile m_CurrentMemoryFile;
+  EntryDeviceFactory m_EntryDeviceFactory;
+  QIODevice* m_CurrentEntryDevice = nullptr;
+  qint64 n_EntryDeviceOffset = 0;
+  // Must outlive the reader of m_ArchiveRead which reads from it.
+  std::unique_ptr<ParallelFilterReader> m_ParallelFilter;
   QSharedPointer<struct archive> m_ArchiveRead;
   QSharedPointer<struct archive> m_ArchiveWrite;
   QStringList m_ExtractFilters;
+  QStringList m_ExtractEntries;  // Only for the run of extractEntries().
+  QSet<QByteArray> m_PendingEntries;
+  // Set for the entries done before a pause after which the archive is
+  // read again from the start, by their index in the archive.
+  std::vector<char> m_EntriesDone;
   QJsonObject m_Info;
+  // The entries of the archive in the order they are stored, as listed by
+  // processArchiveInformation() or loaded from the index cache. m_Info is
+  // only built from them once getInfo() asks for it.
+  struct IndexEntry {
+    QByteArray pathname;
+    quint32 fileType = 0;
+    qint64 size = 0;
+    qint64 atime = 0;
+    qint64 mtime = 0;
+    qint64 ctime = 0;
+    // Where the header of the entry starts in the archive device, -1 when
+    // the reader cannot be started there, see processArchiveInformation().
+    qint64 headerPosition = -1;
+  };
+  std::vector<IndexEntry> m_Index;
   std::unique_ptr<QVector<MemoryFile>> m_ExtractedFiles;
   std::unique_ptr<ArchiveFilter> m_archiveFilter;
+  std::unique_ptr<ExtractFilter> m_ExtractFilter;
+  EventLoopPump m_EventPump;
+  ProgressThrottle m_ProgressThrottle;
+  QByteArray m_PendingProgressEntry;
+  IOReaderStatistics m_ReadStatistics;
+  std::unique_ptr<EntryPathRewriter> m_PathRewriter;
   bool b_hasBasePath = false;
   QDir m_basePath;
+
+  IOReaderOptions getReaderOptions() const;
 };
 }  // namespace QArchive
 #endif  // QARCHIVE_EXTRACTOR_PRIVATE_HPP_INCLUDED
@@ -1,31 +1,106 @@
 #ifndef QARCHIVE_IO_READER_PRIVATE_HPP_INCLUDED
 #define QARCHIVE_IO_READER_PRIVATE_HPP_INCLUDED
+#include <QByteArray>
+#include <QCache>
+#include <QFile>
 #include <QIODevice>
 #include <QObject>
 #include <QtGlobal>
 
+#include <atomic>
+#include <memory>
+
 namespace QArchive {
+// What a reader did, filled in as it reads.
+struct IOReaderStatistics {
+  int blockSize = 0;
+  qint64 reads = 0;
+  qint64 bytesRead = 0;
+  qint64 cacheHits = 0;
+  qint64 cacheMisses = 0;
+  qint64 skips = 0;
+  qint64 bytesSkipped = 0;
+  bool memoryBacked = false;
+  bool timedOut = false;  // A sequential device stayed without data.
+};
+
+// How an archive is read, see archiveReadOpenQIODevice().
+struct IOReaderOptions {
+  bool dropPageCache = false;
+  int readAheadBlocks = 0;
+  int followTimeout = 0;
+  int sequentialTimeout = 30000;
+  int cacheBlocks = 0;
+  IOReaderStatistics* statistics = nullptr;
+  const std::atomic<bool>* cancelRequested = nullptr;
+  const std::atomic<bool>* pauseRequested = nullptr;
+};
+
+class ReadAhead;
+
 class IOReaderPrivate {
  public:
-  IOReaderPrivate() = default;
+  IOReaderPrivate();
   ~IOReaderPrivate();
 
   Q_DISABLE_COPY(IOReaderPrivate)
 
   void setBlockSize(int);
+  void setDropPageCache(bool);
+  void setStatistics(IOReaderStatistics*);
+  void setReadAhead(int);
+  void setFollowTimeout(int);
+  void setSequentialTimeout(int);
+  void setCancelFlag(const std::atomic<bool>*);
+  void setPauseFlag(const std::atomic<bool>*);
+  void setBlockCache(int);
   void setIODevice(QIODevice*);
 
+  [[gnu::warn_unused_result]] int blockSize() const;
+
   [[gnu::warn_unused_result]] bool isOpen() const;
   [[gnu::warn_unused_result]] bool isReadable() const;
   [[gnu::warn_unused_result]] bool isSequential() const;
+  [[gnu::warn_unused_result]] bool isMemoryBacked() const;
 
   qint64 read(char*);
+  qint64 read(const void**, char*);
   qint64 seek(qint64, /*whence=*/int);
   qint64 skip(qint64);
 
  private:
-  int n_BlockSize = 10204; /* Default. */
+  void updateBlockSize();
+  void adviseRead(qint64);
+  QByteArray* loadCachedBlock(qint64);
+
+  int n_RequestedBlockSize = 0; /* 0 picks it from the device. */
+  int n_BlockSize = 10240;
+  bool b_DropPageCache = false;
+  int n_ReadAheadBlocks = 0;
+  int n_FollowTimeout = 0;
+  int n_SequentialTimeout = 30000;
+  const std::atomic<bool>* m_CancelRequested = nullptr;
+  const std::atomic<bool>* m_PauseRequested = nullptr;
+  int n_CacheBlocks = 0;
+  std::unique_ptr<QCache<qint64, QByteArray>> m_BlockCache;
+  qint64 n_ReadAheadPos = 0;
+  std::unique_ptr<ReadAhead> m_ReadAhead;
+  int n_FileHandle = -1;
+  qint64 n_AdvisedUntil = 0;
+  qint64 n_DroppedUntil = 0;
   QIODevice* m_IODevice = nullptr;
+  IOReaderStatistics* m_Statistics = nullptr;
+
+  // Set when the bytes of the device are already in memory, either as the
+  // data of a QBuffer or as a mapping of a QFile. Reads then hand out
+  // slices of it instead of copying into a buffer.
+  // The position and size are also used by the block cache, which only
+  // touches the device on a miss.
+  const char* m_Memory = nullptr;
+  qint64 n_MemorySize = 0;
+  qint64 n_MemoryPos = 0;
+  QFile* m_MappedFile = nullptr;
+  uchar* m_Mapping = nullptr;
 };
 }  // namespace QArchive
 
@@ -0,0 +1,139 @@
+#ifndef QARCHIVE_PARALLEL_FILTER_PRIVATE_HPP_INCLUDED
+#define QARCHIVE_PARALLEL_FILTER_PRIVATE_HPP_INCLUDED
+#include <QByteArray>
+#include <QIODevice>
+#include <QSharedPointer>
+#include <QtGlobal>
+#include <qarchiveioreader_p.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct archive;
+
+namespace QArchive {
+/* Compresses the stream written to it on a pool of threads and writes the
+ * result to a device, for the gzip and bzip2 formats whose libarchive
+ * filters only use a single thread.
+ * The stream is cut into chunks of a fixed size which are compressed on
+ * their own, as gzip members or bzip2 streams, and written out in order.
+ * Any gzip or bzip2 reader takes the concatenation as a single stream. The
+ * chunks do not depend on the number of threads, so neither does the
+ * output.
+ * Only the thread which writes to it touches the device. */
+class ParallelFilterWriter {
+ public:
+  ParallelFilterWriter(QIODevice* device, short format, int threads,
+                       int level = -1);
+  ~ParallelFilterWriter();
+
+  Q_DISABLE_COPY(ParallelFilterWriter)
+
+  [[gnu::warn_unused_result]] QIODevice* device() const;
+
+  bool write(const char*, qint64);
+  bool finish();
+
+ private:
+  struct Chunk {
+    QByteArray input;
+    QByteArray output;
+    bool started = false;
+    bool done = false;
+    bool failed = false;
+  };
+
+  void run();
+  bool submit();
+  bool writeFinished(size_t);
+  bool compress(Chunk*) const;
+
+  QIODevice* m_Device = nullptr;
+  short n_Format = 0;
+  int n_Level = -1;
+  int n_ChunkSize = 0;
+  size_t n_MaxChunks = 0;
+  bool b_Failed = false;
+  QByteArray m_Current;
+
+  std::deque<std::shared_ptr<Chunk>> m_Chunks;  // Guarded by m_Mutex.
+  bool b_Stop = false;                          // Guarded by m_Mutex.
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::vector<std::thread> m_Threads;
+};
+
+/* Decompresses a gzip stream made of BGZF members or a zstd stream made of
+ * several frames on a pool of threads, and hands out the result in order
+ * as a sequential device for libarchive to read the archive from.
+ * The members and frames are found from their headers without
+ * decompressing them and grouped into chunks which are decompressed on
+ * their own. detect() tells if a device holds such a stream, anything else
+ * has to be decompressed by libarchive as a single stream. A gzip member
+ * which is not a BGZF member has no size in its header, it and everything
+ * after it are decompressed as a single stream once the chunks before it
+ * are handed out.
+ * Only the thread which reads from it touches the source device, which is
+ * read from its current position on. */
+class ParallelFilterReader : public QIODevice {
+ public:
+  ParallelFilterReader(QIODevice* source, short format, int threads);
+  ~ParallelFilterReader() override;
+
+  Q_DISABLE_COPY(ParallelFilterReader)
+
+  static short detect(QIODevice*);
+
+  bool isSequential() const override;
+  [[gnu::warn_unused_result]] qint64 inputPosition() const;
+
+ protected:
+  qint64 readData(char*, qint64) override;
+  qint64 writeData(const char*, qint64) override;
+
+ private:
+  struct Chunk {
+    QByteArray input;
+    QByteArray output;
+    bool started = false;
+    bool done = false;
+    bool failed = false;
+  };
+
+  void run();
+  void schedule();
+  std::shared_ptr<Chunk> takeChunk();
+  int readMember(QByteArray*);
+  int leaveTail(QByteArray*, int);
+  int readFrame(QByteArray*);
+  bool readSource(QByteArray*, qint64);
+  bool decompress(Chunk*) const;
+  qint64 readTail(char*, qint64);
+
+  QIODevice* m_Source = nullptr;
+  short n_Format = 0;
+  size_t n_MaxChunks = 0;
+  qint64 n_InputPosition = 0;
+  bool b_InputDone = false;
+  bool b_Failed = false;
+  std::shared_ptr<Chunk> m_Current;
+  int n_CurrentPos = 0;
+
+  // Set once the rest of the source is left to a single stream.
+  bool b_Tail = false;
+  QSharedPointer<struct archive> m_Tail;
+  IOReaderStatistics m_TailStatistics;
+
+  std::deque<std::shared_ptr<Chunk>> m_Chunks;  // Guarded by m_Mutex.
+  bool b_Stop = false;                          // Guarded by m_Mutex.
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::vector<std::thread> m_Threads;
+};
+}  // namespace QArchive
+
+#endif  // QARCHIVE_PARALLEL_FILTER_PRIVATE_HPP_INCLUDED
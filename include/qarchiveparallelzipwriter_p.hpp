@@ -0,0 +1,102 @@
+#ifndef QARCHIVE_PARALLEL_ZIP_WRITER_PRIVATE_HPP_INCLUDED
+#define QARCHIVE_PARALLEL_ZIP_WRITER_PRIVATE_HPP_INCLUDED
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace QArchive {
+/* Writes a ZIP archive whose entries are deflated on a pool of threads.
+ * ZIP entries are compressed on their own, so every entry is deflated as a
+ * whole by one of the threads while the thread which writes to the device
+ * puts the local headers, the data and the central directory out in the
+ * order the entries were added. The output does not depend on the number
+ * of threads.
+ * Entries are read from a file by the threads or handed over in memory.
+ * Large entries are deflated to a temporary file instead of memory.
+ * At level 0 the entries are stored instead of deflated.
+ * Only the thread which writes to it touches the device. */
+class ParallelZipWriter {
+ public:
+  ParallelZipWriter(QIODevice* device, int threads, int level = -1);
+  ~ParallelZipWriter();
+
+  Q_DISABLE_COPY(ParallelZipWriter)
+
+  [[gnu::warn_unused_result]] size_t pending() const;
+  [[gnu::warn_unused_result]] bool isFull() const;
+
+  void addFile(const QString& entry,
+               const QString& path,
+               quint32 mode,
+               qint64 mtime);
+  void addData(const QString& entry, const QByteArray& data);
+  short writeNext(qint64* bytes);
+  short finish();
+
+ private:
+  struct Entry {
+    ~Entry();
+
+    QByteArray name;
+    QString path;
+    QByteArray input;
+    quint32 mode = 0;
+    qint64 mtime = 0;
+    quint32 crc = 0;
+    quint16 method = 8;
+    qint64 size = 0;
+    qint64 compressedSize = 0;
+    qint64 dataOffset = 0;
+    QByteArray output;
+    FILE* spill = nullptr;
+    qint64 outputSize = 0;
+    short error = 0;
+    bool started = false;
+    bool done = false;
+  };
+
+  struct Record {
+    QByteArray name;
+    quint32 mode;
+    qint64 mtime;
+    quint32 crc;
+    quint16 method;
+    qint64 size;
+    qint64 compressedSize;
+    qint64 offset;
+  };
+
+  void run();
+  void submit(const std::shared_ptr<Entry>&);
+  short compress(Entry*) const;
+  short store(Entry*, QFile*, qint64) const;
+  bool writeEntry(Entry*);
+  bool writeData(const Entry*);
+  bool write(const QByteArray&);
+
+  QIODevice* m_Device = nullptr;
+  int n_Level = -1;
+  size_t n_MaxEntries = 0;
+  qint64 n_Offset = 0;
+  std::vector<Record> m_Records;
+
+  std::deque<std::shared_ptr<Entry>> m_Entries;  // Guarded by m_Mutex.
+  std::atomic<bool> b_Stop{false};
+  mutable std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::vector<std::thread> m_Threads;
+};
+}  // namespace QArchive
+
+#endif  // QARCHIVE_PARALLEL_ZIP_WRITER_PRIVATE_HPP_INCLUDED
@@ -9,25 +9,89 @@
 #define OperationPaused (-2)
 #endif
 
+#include <QElapsedTimer>
+
+#include <cstddef>
+
 struct archive;
 struct archive_entry;
+class QDateTime;
+class QFileInfo;
 class QString;
 class QIODevice;
 
+namespace QArchive {
+struct IOReaderOptions;
+}
+
 /* Smart pointer destructors. */
 void ArchiveReadDestructor(archive*);
 void ArchiveWriteDestructor(archive*);
 void ArchiveEntryDestructor(archive_entry*);
 
-/* Open Archive from QIODevice. (non-sequential) */
+/* Open Archive from QIODevice. Sequential devices are read through without
+ * seeking. A blocksize of 0 picks one from the device. */
 int archiveReadOpenQIODevice(struct archive* archive, int blocksize,
                              QIODevice* device);
+int archiveReadOpenQIODevice(struct archive* archive, int blocksize,
+                             QIODevice* device,
+                             const QArchive::IOReaderOptions& options);
 
 /* Write Archive to QIODevice. */
 int archiveWriteOpenQIODevice(struct archive* archive, QIODevice* device);
 
+/* Write Archive to QIODevice, compressed as gzip or bzip2 on the given
+ * number of threads. */
+int archiveWriteOpenParallelFilter(struct archive* archive, QIODevice* device,
+                                   short format, int threads, int level,
+                                   bool closeDevice);
+
+/* Pumps the event loop of the calling thread at most once every interval
+ * milliseconds, so long running loops stay responsive without paying for
+ * QCoreApplication::processEvents() on every block.
+ * An interval of 0 pumps it on every call. */
+class EventLoopPump {
+ public:
+  void setInterval(int);
+  int interval() const;
+  void pump();
+
+ private:
+  int n_Interval = 50;
+  QElapsedTimer m_Timer;
+};
+
+/* Decides which progress updates are emitted. An update passes once the
+ * interval has elapsed and the minimum bytes were processed since the last
+ * emitted update, with perEntryOnly only updates at the end of an entry
+ * pass. Everything passes by default.
+ * hasPending() tells if a suppressed update has to be emitted at the end. */
+class ProgressThrottle {
+ public:
+  void setInterval(int);
+  void setMinimumBytes(qint64);
+  void setPerEntryOnly(bool);
+  void reset();
+  bool pass(qint64, bool);
+  bool hasPending() const;
+
+ private:
+  int n_Interval = 0;
+  qint64 n_MinimumBytes = 0;
+  qint64 n_LastBytes = 0;
+  bool b_PerEntryOnly = false;
+  bool b_Pending = false;
+  QElapsedTimer m_Timer;
+};
+
+/* File metadata the way libarchive stores it. */
+qint64 getSecsSinceEpoch(const QDateTime&);
+quint32 getUnixMode(const QFileInfo&);
+
 /* Basic string manupilators.  */
 char* concat(const char*, const char*);
 QString getDirectoryFileName(const QString&);
 bool isUTF8(const char*);
+bool isASCII(const char*, size_t);
+bool isValidUTF8(const char*, size_t);
 #endif  // QARCHIVE_UTILS_PRIVATE_HPP_INCLUDED
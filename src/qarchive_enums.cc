@@ -39,6 +39,8 @@ QString QArchive::errorCodeToString(short errorCode) {
       return "QArchive::InvalidOutputDirectory";
     case InvalidArchiveFile:
       return "QArchive::InvalidArchiveFile";
+    case ArchiveReadTimeout:
+      return "QArchive::ArchiveReadTimeout";
     case ArchiveFileNameNotGiven:
       return "QArchive::ArchiveFileNameNotGiven";
     case ArchiveFileAlreadyExists:
@@ -61,6 +63,8 @@ QString QArchive::errorCodeToString(short errorCode) {
       return "QArchive::CannotOpenFile";
     case IODeviceSequential:
       return "QArchive::IODeviceSequential";
+    case InvalidCompressionOption:
+      return "QArchive::InvalidCompressionOption";
     default:
       return "QArchive::UnknownError";
   }
@@ -76,6 +76,42 @@ void Compressor::setBlockSize(int size) {
       .invoke(m_Compressor.get(), Qt::QueuedConnection, Q_ARG(int, size));
 }
 
+void Compressor::setThreads(int n) {
+  getMethod(*m_Compressor, "setThreads(int)")
+      .invoke(m_Compressor.get(), Qt::QueuedConnection, Q_ARG(int, n));
+}
+
+void Compressor::setCompressionLevel(int level) {
+  getMethod(*m_Compressor, "setCompressionLevel(int)")
+      .invoke(m_Compressor.get(), Qt::QueuedConnection, Q_ARG(int, level));
+}
+
+void Compressor::setFilterOptions(const QString& options) {
+  getMethod(*m_Compressor, "setFilterOptions(const QString&)")
+      .invoke(m_Compressor.get(), Qt::QueuedConnection,
+              Q_ARG(QString, options));
+}
+
+void Compressor::setProcessEventsInterval(int ms) {
+  getMethod(*m_Compressor, "setProcessEventsInterval(int)")
+      .invoke(m_Compressor.get(), Qt::QueuedConnection, Q_ARG(int, ms));
+}
+
+void Compressor::setProgressInterval(int ms) {
+  getMethod(*m_Compressor, "setProgressInterval(int)")
+      .invoke(m_Compressor.get(), Qt::QueuedConnection, Q_ARG(int, ms));
+}
+
+void Compressor::setProgressMinimumBytes(qint64 bytes) {
+  getMethod(*m_Compressor, "setProgressMinimumBytes(qint64)")
+      .invoke(m_Compressor.get(), Qt::QueuedConnection, Q_ARG(qint64, bytes));
+}
+
+void Compressor::setProgressPerEntryOnly(bool enabled) {
+  getMethod(*m_Compressor, "setProgressPerEntryOnly(bool)")
+      .invoke(m_Compressor.get(), Qt::QueuedConnection, Q_ARG(bool, enabled));
+}
+
 void Compressor::addFiles(const QString& entry, QIODevice* io) {
   getMethod(*m_Compressor, "addFiles(const QString&, QIODevice*)")
       .invoke(m_Compressor.get(), Qt::QueuedConnection, Q_ARG(QString, entry),
@@ -148,12 +184,16 @@ void Compressor::start() {
       .invoke(m_Compressor.get(), Qt::QueuedConnection);
 }
 
+// The request is seen right away by a running compression, the queued call
+// covers a compression which is yet to start.
 void Compressor::cancel() {
+  m_Compressor->requestCancel();
   getMethod(*m_Compressor, "cancel()")
       .invoke(m_Compressor.get(), Qt::QueuedConnection);
 }
 
 void Compressor::pause() {
+  m_Compressor->requestPause();
   getMethod(*m_Compressor, "pause()")
       .invoke(m_Compressor.get(), Qt::QueuedConnection);
 }
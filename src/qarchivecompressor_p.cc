@@ -1,10 +1,11 @@
-#include <QCoreApplication>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QElapsedTimer>
 #include <QFileInfo>
+#include <QThread>
 
+#include <algorithm>
 #include <deque>
 
 #include "qarchive_enums.hpp"
@@ -31,6 +32,30 @@ bool contains(const QString& entry,
                        return n && n->valid && n->entry == entry;
                      });
 }
+
+// Gives the range of compression levels libarchive takes for the format,
+// false if the format does not compress.
+bool getCompressionLevelRange(short format, int* min, int* max) {
+  switch (format) {
+    case TarFormat:
+      return false;
+    case BZipFormat:
+    case BZip2Format:
+      *min = 1;
+      *max = 9;
+      return true;
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+    case ZstdFormat:  // Falls back to ZIP with an older libarchive.
+      *min = 1;
+      *max = 22;
+      return true;
+#endif
+    default:  // ZIP, 7-Zip, gzip, xz and xar.
+      *min = 0;
+      *max = 9;
+      return true;
+  }
+}
 }  // namespace
 
 // Node is a private structure which is used store info about entries to be
@@ -128,6 +153,71 @@ void CompressorPrivate::setBlockSize(int size) {
   n_BlockSize = size;
 }
 
+// Sets the number of threads ZIP, xz, zstd, gzip and bzip2 compress with
+// and directories are scanned on, 0 uses one for every core. The other
+// formats always compress on a single thread.
+// This is not cleared by clear().
+void CompressorPrivate::setThreads(int n) {
+  if (b_Started || b_Paused || n < 0) {
+    return;
+  }
+  n_Threads = n;
+}
+
+// Sets the compression level of the archive, -1 keeps the default of
+// libarchive. The range depends on the format and is checked on start().
+// Like the format, this is cleared by clear().
+void CompressorPrivate::setCompressionLevel(int level) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  n_CompressionLevel = level;
+}
+
+// Sets libarchive options given as "module:option=value,...", which are
+// passed to archive_write_set_options() as they are. Cleared by clear().
+void CompressorPrivate::setFilterOptions(const QString& options) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  m_FilterOptions = options;
+}
+
+// Emits progress at most once every given milliseconds, 0 disables the
+// limit. The progress at the end of the compression is always emitted.
+// This and the other progress limits are not cleared by clear().
+void CompressorPrivate::setProgressInterval(int ms) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  m_ProgressThrottle.setInterval(ms);
+}
+
+// Emits progress only after at least the given bytes were processed since
+// the last emitted progress, 0 disables the limit.
+void CompressorPrivate::setProgressMinimumBytes(qint64 bytes) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  m_ProgressThrottle.setMinimumBytes(bytes);
+}
+
+// Emits progress only when a file is fully written instead of after
+// every block.
+void CompressorPrivate::setProgressPerEntryOnly(bool enabled) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  m_ProgressThrottle.setPerEntryOnly(enabled);
+}
+
+// Sets how often the event loop is processed while compressing, in
+// milliseconds. Pause and cancel requests do not depend on it.
+// This is not cleared by clear().
+void CompressorPrivate::setProcessEventsInterval(int ms) {
+  m_EventPump.setInterval(ms);
+}
+
 void CompressorPrivate::addFiles(const QString& entryName, QIODevice* device) {
   if (b_Started || b_Paused) {
     return;
@@ -271,13 +361,18 @@ void CompressorPrivate::clear() {
   m_Password.clear();
 #endif
 
+  // What the archive is made of is reset, the number of threads and the
+  // progress and event settings only change how fast it is made and stay.
   m_ArchiveFormat = 0;
   n_BlockSize = 10240;
+  n_CompressionLevel = -1;
+  m_FilterOptions.clear();
 
   // TODO: do we need to reset n_BytesTotal here?
   n_BytesProcessed = 0;
   n_BytesTotal = 0;
 
+  m_ParallelZip.reset();
   qDeleteAll(m_ConfirmedFiles);
   m_ConfirmedFiles.clear();
   qDeleteAll(m_StaggedFiles);
@@ -323,12 +418,24 @@ void CompressorPrivate::start() {
     m_ArchiveFormat = ZipFormat;  // Default format.
   }
 
+  int minLevel = 0, maxLevel = 0;
+  if (n_CompressionLevel != -1 &&
+      (!getCompressionLevelRange(m_ArchiveFormat, &minLevel, &maxLevel) ||
+       n_CompressionLevel < minLevel || n_CompressionLevel > maxLevel)) {
+    emit error(InvalidCompressionOption,
+               !b_MemoryMode ? m_TemporaryFile->fileName() : "");
+    return;
+  }
+
   /// Confirm files.
   n_BytesTotal = 0;
   if (!confirmFiles()) {
     return;
   }
 
+  // Requests made before this point are for an earlier compression.
+  b_PauseRequested = b_CancelRequested = false;
+  m_ProgressThrottle.reset();
   b_Started = true;
   b_Finished = false;
   emit started();
@@ -365,6 +472,7 @@ void CompressorPrivate::resume() {
     return;
   }
   b_Paused = false;
+  b_PauseRequested = b_CancelRequested = false;
   b_Started = true;
   emit resumed();
 
@@ -402,6 +510,18 @@ void CompressorPrivate::pause() {
   b_PauseRequested = true;
 }
 
+// Requests the running compression to pause, unlike pause() this can be
+// called from any thread. The request is dropped when a compression starts
+// or resumes, the queued pause() covers a compression which is yet to start.
+void CompressorPrivate::requestPause() {
+  b_PauseRequested = true;
+}
+
+// Requests the running compression to cancel, can be called from any thread.
+void CompressorPrivate::requestCancel() {
+  b_CancelRequested = true;
+}
+
 // Cancels the current compression process, if the compression process is
 // paused then the compression cannot be canceled.
 void CompressorPrivate::cancel() {
@@ -464,6 +584,9 @@ bool CompressorPrivate::guessArchiveFormat() {
 bool CompressorPrivate::confirmFiles() {
   qDeleteAll(m_ConfirmedFiles);
   m_ConfirmedFiles.clear();
+  // Directories are scanned on as many threads as the compression uses.
+  const int threads =
+      n_Threads > 0 ? n_Threads : qMax(QThread::idealThreadCount(), 1);
   for (const auto& node : m_StaggedFiles) {
     short eCode = node->open();
     if (eCode != NoError) {
@@ -494,40 +617,31 @@ bool CompressorPrivate::confirmFiles() {
       // if directory then add files in directory
       // recursively.
       if (info.isDir()) {
-        std::deque<QString> dirList;
-        QString toReplace = info.filePath();
-        dirList.push_back(info.filePath());
-
-        while (!dirList.empty()) {
-          QDir dir(dirList.front());
-          dirList.pop_front();
-          QFileInfoList list = dir.entryInfoList(
-              QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
-          for (const auto& i : list) {
-            if (i.isDir()) {
-              dirList.push_back(i.filePath());
-              continue;
-            }
-            QString file = i.filePath();
-            auto fileNode = new Node;
-            fileNode->isInMemory = node->isInMemory;
-            fileNode->valid = node->valid;
-            fileNode->path = file;
-
-            auto len = toReplace.length();
-
-            if (toReplace[len - 1] == '/' || toReplace[len - 1] == '\\') {
-              len = node->entry.length();
-              if (node->entry[len - 1] != '/' && node->entry[len - 1] != '\\') {
-                node->entry.push_back('/');
-              }
-            }
-            fileNode->entry = file.replace(toReplace, node->entry);
-
-            m_ConfirmedFiles.push_back(fileNode);
-
-            n_BytesTotal += QFileInfo(i.filePath()).size();
-          }
+        // The paths of the files are relative to the directory, both the
+        // directory and the entry get a separator to put them after.
+        QString root = info.filePath();
+        QString prefix = node->entry;
+        if (!root.endsWith('/') && !root.endsWith('\\')) {
+          root.push_back('/');
+          prefix.push_back('/');
+        } else if (!prefix.endsWith('/') && !prefix.endsWith('\\')) {
+          prefix.push_back('/');
+        }
+
+        DirectoryScanner scanner(threads);
+        for (auto& file : scanner.scan(info.filePath())) {
+          auto fileNode = new Node;
+          fileNode->isInMemory = node->isInMemory;
+          fileNode->valid = node->valid;
+          fileNode->path = root + file.path;
+          fileNode->entry = prefix + file.path;
+          fileNode->size = file.size;
+          fileNode->mtime = file.mtime;
+          fileNode->mode = file.mode;
+          fileNode->isSymLink = file.isSymLink;
+          m_ConfirmedFiles.push_back(fileNode);
+
+          n_BytesTotal += file.size;
         }
       } else {  // Add it to the confirmed list.
         auto fileNode = new Node;
@@ -535,8 +649,12 @@ bool CompressorPrivate::confirmFiles() {
         fileNode->valid = node->valid;
         fileNode->path = info.filePath();
         fileNode->entry = node->entry;
+        fileNode->size = info.size();
+        fileNode->mtime = getSecsSinceEpoch(info.lastModified());
+        fileNode->mode = getUnixMode(info);
+        fileNode->isSymLink = info.isSymLink();
         m_ConfirmedFiles.push_back(fileNode);
-        n_BytesTotal += info.size();
+        n_BytesTotal += fileNode->size;
       }
     } else {  // If QIODevice given
       auto fileNode = new Node;
@@ -562,6 +680,9 @@ bool CompressorPrivate::confirmFiles() {
 
 // Does the compression and also resumes it if called twice.
 short CompressorPrivate::compress() {
+  if (m_ParallelZip) {
+    return compressParallelZip();
+  }
   if (!m_ArchiveWrite) {
     /// Open Temporary file for write.
     if (!b_MemoryMode && !m_TemporaryFile->open(QIODevice::WriteOnly)) {
@@ -569,6 +690,34 @@ short CompressorPrivate::compress() {
       return ArchiveWriteOpenError;
     }
 
+    const int threads =
+        n_Threads > 0 ? n_Threads : qMax(QThread::idealThreadCount(), 1);
+
+    // ZIP entries are compressed on their own, so they are deflated on the
+    // threads and written by a ParallelZipWriter instead of libarchive.
+    // Encrypted entries, anything but regular files and options only
+    // libarchive knows about are left to libarchive.
+    if (threads > 1 && m_ArchiveFormat == ZipFormat && m_Password.isEmpty() &&
+        m_FilterOptions.isEmpty() &&
+        std::all_of(m_ConfirmedFiles.begin(), m_ConfirmedFiles.end(),
+                    [](const Node* n) {
+                      return n->isInMemory ||
+                             (!n->isSymLink && (n->mode & 0170000) == 0100000);
+                    })) {
+      if (b_MemoryMode && !m_Buffer->isOpen() &&
+          !m_Buffer->open(QIODevice::WriteOnly)) {
+        emit error(ArchiveWriteOpenError, {});
+        return ArchiveWriteOpenError;
+      }
+      QIODevice* device = b_MemoryMode
+                              ? static_cast<QIODevice*>(m_Buffer.get())
+                              : static_cast<QIODevice*>(m_TemporaryFile.get());
+      m_ParallelZip.reset(
+          new ParallelZipWriter(device, threads, n_CompressionLevel));
+      n_TotalEntries = m_ConfirmedFiles.size();  // for reporting progress.
+      return compressParallelZip();
+    }
+
     m_ArchiveWrite = QSharedPointer<struct archive>(archive_write_new(),
                                                     ArchiveWriteDestructor);
     if (!m_ArchiveWrite) {
@@ -577,14 +726,34 @@ short CompressorPrivate::compress() {
       return NotEnoughMemory;
     }
 
+    // The gzip and bzip2 filters of libarchive only use a single thread, the
+    // tar stream is compressed by a ParallelFilterWriter instead then.
+    short parallelFilter = 0;
+    if (threads > 1 && m_FilterOptions.isEmpty()) {
+      if (m_ArchiveFormat == GZipFormat) {
+        parallelFilter = GZipFormat;
+      } else if (m_ArchiveFormat == BZipFormat ||
+                 m_ArchiveFormat == BZip2Format) {
+        parallelFilter = BZip2Format;
+      }
+    }
+
     switch (m_ArchiveFormat) {
       case BZipFormat:
       case BZip2Format:
-        archive_write_add_filter_bzip2(m_ArchiveWrite.data());
+        if (parallelFilter) {
+          archive_write_add_filter_none(m_ArchiveWrite.data());
+        } else {
+          archive_write_add_filter_bzip2(m_ArchiveWrite.data());
+        }
         archive_write_set_format_gnutar(m_ArchiveWrite.data());
         break;
       case GZipFormat:
-        archive_write_add_filter_gzip(m_ArchiveWrite.data());
+        if (parallelFilter) {
+          archive_write_add_filter_none(m_ArchiveWrite.data());
+        } else {
+          archive_write_add_filter_gzip(m_ArchiveWrite.data());
+        }
         archive_write_set_format_gnutar(m_ArchiveWrite.data());
         break;
       case XzFormat:
@@ -629,6 +798,51 @@ short CompressorPrivate::compress() {
         break;
     }
 
+    // libarchive splits the xz and zstd streams into blocks which are
+    // compressed in parallel when given more than one thread.
+    if (threads > 1) {
+      const auto value = QByteArray::number(threads);
+#if ARCHIVE_VERSION_NUMBER >= 3002000
+      if (m_ArchiveFormat == XzFormat) {
+        archive_write_set_filter_option(m_ArchiveWrite.data(), "xz",
+                                        "threads", value.constData());
+      }
+#endif
+#if ARCHIVE_VERSION_NUMBER >= 3006000
+      if (m_ArchiveFormat == ZstdFormat) {
+        archive_write_set_filter_option(m_ArchiveWrite.data(), "zstd",
+                                        "threads", value.constData());
+      }
+#endif
+      Q_UNUSED(value);
+    }
+
+    // A ParallelFilterWriter sets the level of its own filter. Otherwise the
+    // level goes to the filter when one was added, the tar formats are
+    // compressed by it, and to the format when not. This follows the
+    // filter, not the format asked for, since zstd falls back to ZIP.
+    int r = ARCHIVE_OK;
+    if (n_CompressionLevel != -1 && !parallelFilter) {
+      const auto value = QByteArray::number(n_CompressionLevel);
+      r = archive_filter_count(m_ArchiveWrite.data()) > 0
+              ? archive_write_set_filter_option(m_ArchiveWrite.data(), nullptr,
+                                                "compression-level",
+                                                value.constData())
+              : archive_write_set_format_option(m_ArchiveWrite.data(), nullptr,
+                                                "compression-level",
+                                                value.constData());
+    }
+    if (r == ARCHIVE_OK && !m_FilterOptions.isEmpty()) {
+      r = archive_write_set_options(m_ArchiveWrite.data(),
+                                    m_FilterOptions.toUtf8().constData());
+    }
+    if (r != ARCHIVE_OK) {
+      m_ArchiveWrite.clear();
+      emit error(InvalidCompressionOption,
+                 !b_MemoryMode ? m_TemporaryFile->fileName() : "");
+      return InvalidCompressionOption;
+    }
+
       // Set Password if the format is Zip and a password is given by the user.
       //
       // Note:
@@ -648,7 +862,23 @@ short CompressorPrivate::compress() {
       archive_write_set_bytes_per_block(m_ArchiveWrite.data(), n_BlockSize);
     }
 
-    if (!b_MemoryMode) {
+    if (parallelFilter) {
+      // The temporary file is committed later, so only the buffer is closed
+      // with the archive.
+      QIODevice* device = b_MemoryMode
+                              ? static_cast<QIODevice*>(m_Buffer.get())
+                              : static_cast<QIODevice*>(m_TemporaryFile.get());
+      if (archiveWriteOpenParallelFilter(m_ArchiveWrite.data(), device,
+                                         parallelFilter, threads,
+                                         n_CompressionLevel,
+                                         /*closeDevice=*/b_MemoryMode) !=
+          ARCHIVE_OK) {
+        m_ArchiveWrite.clear();
+        emit error(ArchiveWriteOpenError,
+                   !b_MemoryMode ? m_TemporaryFile->fileName() : "");
+        return ArchiveWriteOpenError;
+      }
+    } else if (!b_MemoryMode) {
       // Finally open the write archive using the handle of the Temporary file.
       if (archive_write_open_fd(m_ArchiveWrite.data(),
                                 m_TemporaryFile->handle()) != ARCHIVE_OK) {
@@ -729,11 +959,11 @@ short CompressorPrivate::compress() {
             archive_write_data(m_ArchiveWrite.data(), buff, len);
             n_BytesProcessed += len;
 
-            emit progress(node->entry,
-                          (n_TotalEntries - (m_ConfirmedFiles.size() - 1)),
-                          n_TotalEntries, n_BytesProcessed, n_BytesTotal);
+            reportProgress(node->entry,
+                           (n_TotalEntries - (m_ConfirmedFiles.size() - 1)),
+                           /*entryDone=*/false);
 
-            QCoreApplication::processEvents();
+            m_EventPump.pump();
             len = file.read(buff, sizeof(buff));
           }
           file.close();
@@ -742,7 +972,7 @@ short CompressorPrivate::compress() {
           return ArchiveHeaderWriteError;
         }
 
-        QCoreApplication::processEvents();
+        m_EventPump.pump();
       }
     } else {
       QSharedPointer<struct archive_entry> entry(archive_entry_new(),
@@ -784,23 +1014,23 @@ short CompressorPrivate::compress() {
         archive_write_data(m_ArchiveWrite.data(), buff, len);
         n_BytesProcessed += len;
 
-        emit progress(node->entry,
-                      (n_TotalEntries - (m_ConfirmedFiles.size() - 1)),
-                      n_TotalEntries, n_BytesProcessed, n_BytesTotal);
+        reportProgress(node->entry,
+                       (n_TotalEntries - (m_ConfirmedFiles.size() - 1)),
+                       /*entryDone=*/false);
 
-        QCoreApplication::processEvents();
+        m_EventPump.pump();
         len = (node->io)->read(buff, sizeof(buff));
       }
     }
 
     m_ConfirmedFiles.pop_front();
 
-    emit progress(node->entry, (n_TotalEntries - m_ConfirmedFiles.size()),
-                  n_TotalEntries, n_BytesProcessed, n_BytesTotal);
+    reportProgress(node->entry, (n_TotalEntries - m_ConfirmedFiles.size()),
+                   /*entryDone=*/true);
 
     delete node;
 
-    QCoreApplication::processEvents();
+    m_EventPump.pump();
     if (b_PauseRequested) {
       b_PauseRequested = false;
       return OperationPaused;
@@ -813,6 +1043,94 @@ short CompressorPrivate::compress() {
       return OperationCanceled;
     }
   }
+  // The final progress is always emitted.
+  if (m_ProgressThrottle.hasPending()) {
+    emit progress(m_PendingProgressEntry, n_PendingProcessedEntries,
+                  n_TotalEntries, n_BytesProcessed, n_BytesTotal);
+    m_ProgressThrottle.reset();
+  }
   m_ArchiveWrite.clear();
   return NoError;
 }
+
+// Does the compression through m_ParallelZip, the threads deflate the
+// entries ahead of the one written next. Progress is reported per entry.
+short CompressorPrivate::compressParallelZip() {
+  while (!m_ConfirmedFiles.empty()) {
+    while (m_ParallelZip->pending() < m_ConfirmedFiles.size() &&
+           !m_ParallelZip->isFull()) {
+      auto next = m_ConfirmedFiles[m_ParallelZip->pending()];
+      if (next->isInMemory) {
+        (next->io)->seek(0);
+        m_ParallelZip->addData(next->entry, (next->io)->readAll());
+      } else {
+        m_ParallelZip->addFile(next->entry, next->path, next->mode,
+                               next->mtime);
+      }
+    }
+
+    auto node = m_ConfirmedFiles.front();
+    qint64 bytes = 0;
+    const short ret = m_ParallelZip->writeNext(&bytes);
+    if (ret != NoError) {
+      m_ParallelZip.reset();
+      emit error(ret, !node->isInMemory ? node->path : node->entry);
+      return ret;
+    }
+    n_BytesProcessed += bytes;
+
+    m_ConfirmedFiles.pop_front();
+
+    reportProgress(node->entry, (n_TotalEntries - m_ConfirmedFiles.size()),
+                   /*entryDone=*/true);
+
+    delete node;
+
+    m_EventPump.pump();
+    if (b_PauseRequested) {
+      b_PauseRequested = false;
+      return OperationPaused;
+    }
+
+    if (b_CancelRequested) {
+      b_CancelRequested = false;
+      m_ConfirmedFiles.clear();
+      m_ParallelZip.reset();
+      return OperationCanceled;
+    }
+  }
+
+  const short ret = m_ParallelZip->finish();
+  m_ParallelZip.reset();
+  if (b_MemoryMode) {
+    m_Buffer->close();
+  }
+  if (ret != NoError) {
+    emit error(ret, !b_MemoryMode ? m_TemporaryFile->fileName() : "");
+    return ret;
+  }
+
+  // The final progress is always emitted.
+  if (m_ProgressThrottle.hasPending()) {
+    emit progress(m_PendingProgressEntry, n_PendingProcessedEntries,
+                  n_TotalEntries, n_BytesProcessed, n_BytesTotal);
+    m_ProgressThrottle.reset();
+  }
+  return NoError;
+}
+
+// Emits the progress for the given entry unless the progress throttle
+// holds it back, in which case it is kept to be emitted at the end.
+void CompressorPrivate::reportProgress(const QString& entry,
+                                       int processedEntries,
+                                       bool entryDone) {
+  if (!m_ProgressThrottle.pass(n_BytesProcessed, entryDone)) {
+    if (m_ProgressThrottle.hasPending()) {
+      m_PendingProgressEntry = entry;
+      n_PendingProcessedEntries = processedEntries;
+    }
+    return;
+  }
+  emit progress(entry, processedEntries, n_TotalEntries, n_BytesProcessed,
+                n_BytesTotal);
+}
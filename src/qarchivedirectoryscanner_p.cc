@@ -0,0 +1,196 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <qarchivedirectoryscanner_p.hpp>
+#include <qarchiveutils_p.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <set>
+#include <thread>
+#include <utility>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace QArchive;
+
+namespace {
+// QDir sorts by name ignoring the case by default.
+bool lessByPath(const QString& a, const QString& b) {
+  return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+}
+}  // namespace
+
+DirectoryScanner::DirectoryScanner(int threads)
+    : n_Threads(qMax(threads, 1)) {}
+
+std::vector<DirectoryScanner::File> DirectoryScanner::scan(
+    const QString& root) {
+  Directory top;
+  top.path = root;
+  m_Queue.push_back(&top);
+
+  // The calling thread is one of the threads.
+  std::vector<std::thread> threads;
+  for (int i = 1; i < n_Threads; ++i) {
+    threads.emplace_back(&DirectoryScanner::run, this);
+  }
+  run();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Put the files in the order of a breadth-first walk. A directory reached
+  // again through a link is dropped here and not while reading, so the one
+  // kept does not depend on which thread got to it first.
+  std::vector<File> files;
+  std::set<std::pair<quint64, quint64>> visited;
+  std::deque<Directory*> pending{&top};
+  while (!pending.empty()) {
+    Directory* dir = pending.front();
+    pending.pop_front();
+    if (dir->identified &&
+        !visited.emplace(dir->device, dir->inode).second) {
+      continue;
+    }
+    std::move(dir->files.begin(), dir->files.end(),
+              std::back_inserter(files));
+    for (auto& child : dir->children) {
+      pending.push_back(child.get());
+    }
+  }
+  return files;
+}
+
+// Reads the queued directories until all of them are read, the directories
+// found are queued for any of the threads.
+void DirectoryScanner::run() {
+  for (;;) {
+    Directory* dir = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_Condition.wait(lock,
+                       [this]() { return !m_Queue.empty() || n_Busy == 0; });
+      if (m_Queue.empty()) {
+        break;
+      }
+      dir = m_Queue.front();
+      m_Queue.pop_front();
+      ++n_Busy;
+    }
+
+    read(dir);
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      for (auto& child : dir->children) {
+        m_Queue.push_back(child.get());
+      }
+      --n_Busy;
+    }
+    m_Condition.notify_all();
+  }
+  m_Condition.notify_all();
+}
+
+#ifdef Q_OS_UNIX
+void DirectoryScanner::read(Directory* dir) {
+  const int fd = ::open(QFile::encodeName(dir->path).constData(),
+                        O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return;
+  }
+  dir->device = st.st_dev;
+  dir->inode = st.st_ino;
+  dir->identified = true;
+
+  // A link to a directory it is in would be followed forever. The parents
+  // were read before this one was queued, so they are known already.
+  for (auto parent = dir->parent; parent; parent = parent->parent) {
+    if (parent->device == dir->device && parent->inode == dir->inode) {
+      ::close(fd);
+      return;
+    }
+  }
+  DIR* stream = fdopendir(fd);
+  if (!stream) {
+    ::close(fd);
+    return;
+  }
+
+  while (struct dirent* entry = readdir(stream)) {
+    const char* name = entry->d_name;
+    if (!strcmp(name, ".") || !strcmp(name, "..")) {
+      continue;
+    }
+    if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+      continue;
+    }
+    const bool isSymLink = S_ISLNK(st.st_mode);
+    if (isSymLink && fstatat(fd, name, &st, 0) != 0) {
+      continue;  // A broken link, which QDir does not list either.
+    }
+
+    const QString fileName = QFile::decodeName(name);
+    if (S_ISDIR(st.st_mode)) {
+      std::unique_ptr<Directory> child(new Directory);
+      child->path = dir->path + '/' + fileName;
+      child->relativePath = dir->relativePath + fileName + '/';
+      child->parent = dir;
+      dir->children.push_back(std::move(child));
+    } else if (S_ISREG(st.st_mode)) {
+      File file;
+      file.path = dir->relativePath + fileName;
+      file.size = st.st_size;
+      file.mtime = st.st_mtime;
+      file.mode = st.st_mode;
+      file.isSymLink = isSymLink;
+      dir->files.push_back(std::move(file));
+    }
+  }
+  closedir(stream);  // Closes fd too.
+
+  std::sort(dir->files.begin(), dir->files.end(),
+            [](const File& a, const File& b) {
+              return lessByPath(a.path, b.path);
+            });
+  std::sort(dir->children.begin(), dir->children.end(),
+            [](const std::unique_ptr<Directory>& a,
+               const std::unique_ptr<Directory>& b) {
+              return lessByPath(a->relativePath, b->relativePath);
+            });
+}
+#else
+void DirectoryScanner::read(Directory* dir) {
+  // QDir keeps what it found while listing, so the sizes come for free.
+  const QFileInfoList list = QDir(dir->path).entryInfoList(
+      QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+  for (const auto& info : list) {
+    if (info.isDir()) {
+      std::unique_ptr<Directory> child(new Directory);
+      child->path = info.filePath();
+      child->relativePath = dir->relativePath + info.fileName() + '/';
+      child->parent = dir;
+      dir->children.push_back(std::move(child));
+      continue;
+    }
+    File file;
+    file.path = dir->relativePath + info.fileName();
+    file.size = info.size();
+    file.mtime = getSecsSinceEpoch(info.lastModified());
+    file.mode = getUnixMode(info);
+    file.isSymLink = info.isSymLink();
+    dir->files.push_back(std::move(file));
+  }
+}
+#endif
@@ -16,6 +16,7 @@ QMetaMethod getMethod(const ExtractorPrivate& object, const char* function) {
 
 Extractor::Extractor(bool memoryMode, QObject* parent, bool singleThreaded)
     : QObject(parent) {
+  qRegisterMetaType<EntryDeviceFactory>("EntryDeviceFactory");
 #ifdef __cpp_lib_make_unique
   m_Extractor = std::make_unique<ExtractorPrivate>(memoryMode);
 #else
@@ -53,6 +54,8 @@ Extractor::Extractor(bool memoryMode, QObject* parent, bool singleThreaded)
           &Extractor::extractionRequirePassword, Qt::DirectConnection);
   connect(m_Extractor.get(), &ExtractorPrivate::info, this, &Extractor::info,
           Qt::DirectConnection);
+  connect(m_Extractor.get(), &ExtractorPrivate::statistics, this,
+          &Extractor::statistics, Qt::DirectConnection);
 }
 
 Extractor::~Extractor() {
@@ -90,6 +93,11 @@ void Extractor::setCalculateProgress(bool choice) {
       .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(bool, choice));
 }
 
+void Extractor::setProgressMode(short mode) {
+  getMethod(*m_Extractor, "setProgressMode(short)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(short, mode));
+}
+
 void Extractor::setOutputDirectory(const QString& dir) {
   getMethod(*m_Extractor, "setOutputDirectory(const QString&)")
       .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(QString, dir));
@@ -148,6 +156,72 @@ void Extractor::setRawOutputFilename(const QString& path) {
       .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(QString, path));
 }
 
+void Extractor::setIndexCacheDirectory(const QString& path) {
+  getMethod(*m_Extractor, "setIndexCacheDirectory(const QString&)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(QString, path));
+}
+
+void Extractor::setThreads(int n) {
+  getMethod(*m_Extractor, "setThreads(int)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(int, n));
+}
+
+void Extractor::setProcessEventsInterval(int ms) {
+  getMethod(*m_Extractor, "setProcessEventsInterval(int)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(int, ms));
+}
+
+void Extractor::setProgressInterval(int ms) {
+  getMethod(*m_Extractor, "setProgressInterval(int)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(int, ms));
+}
+
+void Extractor::setProgressMinimumBytes(qint64 bytes) {
+  getMethod(*m_Extractor, "setProgressMinimumBytes(qint64)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(qint64, bytes));
+}
+
+void Extractor::setProgressPerEntryOnly(bool enabled) {
+  getMethod(*m_Extractor, "setProgressPerEntryOnly(bool)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(bool, enabled));
+}
+
+void Extractor::setEntryDeviceFactory(const EntryDeviceFactory& factory) {
+  getMethod(*m_Extractor, "setEntryDeviceFactory(EntryDeviceFactory)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection,
+              Q_ARG(EntryDeviceFactory, factory));
+}
+
+void Extractor::setDropPageCache(bool enabled) {
+  getMethod(*m_Extractor, "setDropPageCache(bool)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(bool, enabled));
+}
+
+void Extractor::setReadAhead(int blocks) {
+  getMethod(*m_Extractor, "setReadAhead(int)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(int, blocks));
+}
+
+void Extractor::setFollowTimeout(int ms) {
+  getMethod(*m_Extractor, "setFollowTimeout(int)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(int, ms));
+}
+
+void Extractor::setSequentialTimeout(int ms) {
+  getMethod(*m_Extractor, "setSequentialTimeout(int)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(int, ms));
+}
+
+void Extractor::setBlockCache(int blocks) {
+  getMethod(*m_Extractor, "setBlockCache(int)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(int, blocks));
+}
+
+void Extractor::setArchiveFormat(short format) {
+  getMethod(*m_Extractor, "setArchiveFormat(short)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(short, format));
+}
+
 void Extractor::clear() {
   getMethod(*m_Extractor, "clear()")
       .invoke(m_Extractor.get(), Qt::QueuedConnection);
@@ -163,12 +237,27 @@ void Extractor::start() {
       .invoke(m_Extractor.get(), Qt::QueuedConnection);
 }
 
+void Extractor::extractEntry(const QString& path) {
+  getMethod(*m_Extractor, "extractEntry(const QString&)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection, Q_ARG(QString, path));
+}
+
+void Extractor::extractEntries(const QStringList& paths) {
+  getMethod(*m_Extractor, "extractEntries(const QStringList&)")
+      .invoke(m_Extractor.get(), Qt::QueuedConnection,
+              Q_ARG(QStringList, paths));
+}
+
+// The request is seen right away by a running extraction, the queued call
+// covers an extraction which is yet to start.
 void Extractor::cancel() {
+  m_Extractor->requestCancel();
   getMethod(*m_Extractor, "cancel()")
       .invoke(m_Extractor.get(), Qt::QueuedConnection);
 }
 
 void Extractor::pause() {
+  m_Extractor->requestPause();
   getMethod(*m_Extractor, "pause()")
       .invoke(m_Extractor.get(), Qt::QueuedConnection);
 }
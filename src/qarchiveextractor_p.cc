@@ -1,6 +1,22 @@
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDateTime>
 #include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "qarchive_enums.hpp"
 #include "qarchiveextractor_p.hpp"
@@ -36,8 +52,9 @@ void MutableMemoryFile::setFileInformation(QJsonObject info) {
   m_FileInformation = std::move(info);
 }
 
+// Takes the ownership of the given buffer.
 void MutableMemoryFile::setBuffer(QBuffer* buffer) {
-  m_Buffer = std::make_shared<QBuffer>(buffer);
+  m_Buffer.reset(buffer);
 }
 
 QJsonObject MutableMemoryFile::getFileInformation() const {
@@ -97,6 +114,322 @@ class ArchiveFilter {
  private:
   QSharedPointer<struct archive> m_match;
 };
+
+// ExtractFilter decides which entries are extracted. Filters match the exact
+// path of an entry through a hash set, and filters ending with a '/' also
+// match everything below that directory through a prefix trie, then the
+// include and exclude patterns of the ArchiveFilter are applied.
+// A lookup costs O(length of the pathname) regardless of the number of
+// filters.
+class ExtractFilter {
+ public:
+  ExtractFilter(const QStringList& filters, const ArchiveFilter* archiveFilter)
+      : m_ArchiveFilter(archiveFilter), m_Terminal(1, false) {
+    for (const auto& filter : filters) {
+      const auto& path = filter.toUtf8();
+      m_Paths.insert(path);
+      if (path.endsWith('/')) {
+        addDirectory(path);
+      }
+    }
+  }
+
+  bool isEntryExtracted(struct archive_entry* entry) const {
+    return matches(archive_entry_pathname(entry)) &&
+           !m_ArchiveFilter->isEntryExcluded(entry);
+  }
+
+ private:
+  bool matches(const char* pathname) const {
+    if (m_Paths.isEmpty()) {
+      return true;
+    }
+    if (!pathname) {
+      return false;
+    }
+    const auto length = static_cast<int>(qstrlen(pathname));
+    if (m_Paths.contains(QByteArray::fromRawData(pathname, length))) {
+      return true;
+    }
+
+    // Walk the trie until a directory filter ends or the path leaves it.
+    int node = 0;
+    for (int i = 0; i < length && m_Terminal.size() > 1; ++i) {
+      auto it = m_Edges.constFind(edgeKey(node, pathname[i]));
+      if (it == m_Edges.constEnd()) {
+        return false;
+      }
+      node = it.value();
+      if (m_Terminal[node]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void addDirectory(const QByteArray& path) {
+    int node = 0;
+    for (auto c : path) {
+      const auto key = edgeKey(node, c);
+      auto it = m_Edges.constFind(key);
+      if (it != m_Edges.constEnd()) {
+        node = it.value();
+        continue;
+      }
+      m_Terminal.push_back(false);
+      node = static_cast<int>(m_Terminal.size()) - 1;
+      m_Edges.insert(key, node);
+    }
+    m_Terminal[node] = true;
+  }
+
+  // The trie is stored as a single edge table keyed by the parent node
+  // and the next byte of the path.
+  static quint64 edgeKey(int node, char c) {
+    return (static_cast<quint64>(node) << 8) | static_cast<unsigned char>(c);
+  }
+
+  const ArchiveFilter* m_ArchiveFilter;
+  QSet<QByteArray> m_Paths;
+  QHash<quint64, int> m_Edges;
+  std::vector<bool> m_Terminal;  // Node 0 is the root.
+};
+
+// EntryPathRewriter maps the pathname of an archive entry to the pathname it
+// is extracted to, with respect to the raw output filename, the base path and
+// the output directory.
+// Pathnames are rewritten on their bytes in buffers reused across entries,
+// on Windows and with a base path on macOS they go through QString and QDir.
+// It does not share any state, so every extraction thread can own one.
+class EntryPathRewriter {
+ public:
+  EntryPathRewriter(bool memoryMode,
+                    const QString& rawOutputFilename,
+                    const QString& basePath,
+                    const QString& outputDirectory)
+      : b_MemoryMode(memoryMode),
+        b_HasBasePath(!basePath.isEmpty()),
+        b_HasOutputDirectory(!outputDirectory.isEmpty()),
+        m_RawOutputFilename(rawOutputFilename),
+        m_BasePath(basePath),
+        m_OutputDirectory(outputDirectory) {
+    if (b_HasBasePath) {
+      const auto& base = QDir::cleanPath(m_BasePath.absolutePath()).toUtf8();
+      for (const auto& component : base.split('/')) {
+        if (!component.isEmpty()) {
+          m_BaseComponents.push_back(component);
+        }
+      }
+    }
+    if (b_HasOutputDirectory) {
+      m_OutputPrefix = m_OutputDirectory.absolutePath().toUtf8();
+      if (!m_OutputPrefix.endsWith('/')) {
+        m_OutputPrefix += '/';
+      }
+    }
+  }
+
+  // Rewrites the pathname of the given entry, returns false if the entry
+  // is the root of the base path and must not be extracted.
+  bool rewrite(struct archive_entry* entry) {
+    if (!b_MemoryMode && !m_RawOutputFilename.isEmpty()) {
+      const auto& path = (QFileInfo(archive_entry_pathname(entry)).path() +
+                          QString::fromUtf8("/") + m_RawOutputFilename)
+                             .toStdWString();
+      archive_entry_copy_pathname_w(entry, path.c_str());
+    }
+#ifndef Q_OS_WIN
+    const char* pathname = archive_entry_pathname(entry);
+    if (pathname) {
+      const auto length = strlen(pathname);
+      // Pathnames which are not UTF-8 can only be kept as the bytes they
+      // are, like ASCII which is the same in every locale.
+      const bool raw =
+          isASCII(pathname, length) || !isValidUTF8(pathname, length);
+      bool extracted = true;
+      if (rewriteBytes(entry, pathname, length, raw, &extracted)) {
+        return extracted;
+      }
+    }
+#endif
+    return rewriteQString(entry);
+  }
+
+ private:
+  // Rewrites the pathname on its bytes, gives the same result as
+  // rewriteQString() for UTF-8 without allocating once the buffers have
+  // grown. raw pathnames are set as they are, others as UTF-8.
+  // Returns false if the pathname needs QDir::cleanPath(), extracted is
+  // set to false for the root of the base path.
+  bool rewriteBytes(struct archive_entry* entry,
+                    const char* pathname,
+                    size_t length,
+                    bool raw,
+                    bool* extracted) {
+    if (b_MemoryMode && !b_HasBasePath) {
+      return true;
+    }
+
+    const char* path = pathname;
+    size_t pathLength = length;
+    if (b_HasBasePath) {
+#ifdef Q_OS_DARWIN
+      // QDir may compare case insensitively on macOS.
+      return false;
+#endif
+      if (!relativeToBasePath(pathname, length)) {
+        return false;
+      }
+      if (m_Relative == ".") {  // Root directory
+        *extracted = false;
+        return true;
+      }
+      path = m_Relative.data();
+      pathLength = m_Relative.size();
+    }
+
+    if (!b_MemoryMode && b_HasOutputDirectory) {
+      if (pathLength == 0) {
+        return false;
+      }
+      // Same as QDir::absoluteFilePath(), absolute paths stay as they are.
+      if (path[0] != '/' && path[0] != ':') {
+        m_Path.assign(m_OutputPrefix.constData(), m_OutputPrefix.size());
+        m_Path.append(path, pathLength);
+        path = m_Path.data();
+        pathLength = m_Path.size();
+      }
+    }
+
+    if (path == pathname) {
+      if (raw) {
+        return true;  // Nothing changed.
+      }
+      // The pathname belongs to the entry, copy it before setting it.
+      m_Path.assign(pathname, length);
+      path = m_Path.data();
+    }
+
+    // UTF-8 is given as such so libarchive converts it properly to the
+    // locale.
+    if (raw) {
+      archive_entry_copy_pathname(entry, path);
+    } else {
+      archive_entry_update_pathname_utf8(entry, path);
+    }
+    return true;
+  }
+
+  // Same as QDir::relativeFilePath() of the base path for "/" + pathname,
+  // the result is stored in m_Relative.
+  // Returns false for pathnames with ".." components, those need
+  // QDir::cleanPath().
+  bool relativeToBasePath(const char* pathname, size_t length) {
+    m_Components.clear();
+    size_t start = 0;
+    for (size_t i = 0; i <= length; ++i) {
+      if (i < length && pathname[i] != '/') {
+        continue;
+      }
+      const size_t n = i - start;
+      if (n == 2 && pathname[start] == '.' && pathname[start + 1] == '.') {
+        return false;
+      }
+      if (n > 0 && !(n == 1 && pathname[start] == '.')) {
+        m_Components.emplace_back(start, n);
+      }
+      start = i + 1;
+    }
+
+    size_t common = 0;
+    while (common < m_BaseComponents.size() && common < m_Components.size()) {
+      const auto& base = m_BaseComponents[common];
+      const auto& component = m_Components[common];
+      if (static_cast<size_t>(base.size()) != component.second ||
+          memcmp(base.constData(), pathname + component.first,
+                 component.second) != 0) {
+        break;
+      }
+      ++common;
+    }
+
+    m_Relative.clear();
+    for (size_t i = common; i < m_BaseComponents.size(); ++i) {
+      m_Relative += "../";
+    }
+    for (size_t i = common; i < m_Components.size(); ++i) {
+      if (i > common) {
+        m_Relative += '/';
+      }
+      m_Relative.append(pathname + m_Components[i].first,
+                        m_Components[i].second);
+    }
+    if (m_Relative.empty()) {
+      m_Relative = ".";
+    }
+    return true;
+  }
+
+  bool rewriteQString(struct archive_entry* entry) const {
+    if (b_HasBasePath) {
+      const auto& relativePath =
+          m_BasePath
+              .relativeFilePath(QString::fromUtf8("/") +
+                                archive_entry_pathname(entry))
+              .toStdWString();
+      if (relativePath == L".") {  // Root directory
+        return false;
+      }
+      archive_entry_copy_pathname_w(entry, relativePath.c_str());
+    }
+    if (b_MemoryMode) {
+      return true;
+    }
+    if (b_HasOutputDirectory) {
+      // The wide pathname is null when it is not in the locale.
+      const wchar_t* pathname = archive_entry_pathname_w(entry);
+      const auto& new_entry =
+          m_OutputDirectory
+              .absoluteFilePath(
+                  pathname ? QString::fromWCharArray(pathname)
+                           : QFile::decodeName(archive_entry_pathname(entry)))
+              .toStdWString();
+      archive_entry_copy_pathname_w(entry, new_entry.c_str());
+    }
+
+    // UTF-8 in archive entry messes up when extracting under Windows
+    // when UTF-8 is not set, to fix this we first get the archive
+    // entry pathname in raw bytes then convert it to wide characters
+    // and set it has the new pathname which should make libarchive
+    // handle it better.
+
+    // Get current pathname
+    auto ptname_cstr = archive_entry_pathname(entry);
+
+    // Check if UTF-8
+    if (isUTF8(ptname_cstr)) {
+      auto ptname = QString::fromUtf8(ptname_cstr);
+
+      auto wstr = ptname.toStdWString();
+      archive_entry_copy_pathname_w(entry, wstr.c_str());
+    }
+    return true;
+  }
+
+  bool b_MemoryMode = false;
+  bool b_HasBasePath = false;
+  bool b_HasOutputDirectory = false;
+  QString m_RawOutputFilename;
+  QDir m_BasePath;
+  QDir m_OutputDirectory;
+  QByteArray m_OutputPrefix;
+  std::vector<QByteArray> m_BaseComponents;
+
+  // Scratch buffers reused for every entry.
+  std::vector<std::pair<size_t, size_t>> m_Components;  // Offset, length.
+  std::string m_Relative;
+  std::string m_Path;
+};
 }  // namespace QArchive
 
 namespace {
@@ -218,6 +551,284 @@ QJsonObject getArchiveEntryInformation(archive_entry* entry, bool bExcluded) {
 
   return CurrentEntry;
 }
+
+// Index cache files start with this magic and version, the version has to
+// be bumped whenever the layout of the file changes.
+const quint32 IndexCacheMagic = 0x51414958; /* QAIX */
+const quint16 IndexCacheVersion = 2;
+
+// Identifies an archive on the disk, a cached index is only used when
+// none of these changed since the index was written.
+struct IndexCacheKey {
+  QString path;
+  qint64 size = -1;
+  qint64 modified = 0;
+  quint64 inode = 0;
+};
+
+bool getIndexCacheKey(const QString& archivePath, IndexCacheKey* key) {
+  QFileInfo info(archivePath);
+  if (!info.exists() || !info.isFile()) {
+    return false;
+  }
+  key->path = info.absoluteFilePath();
+  key->size = info.size();
+  key->modified = info.lastModified().toMSecsSinceEpoch();
+
+  struct stat st;
+  if (stat(QFile::encodeName(key->path).constData(), &st) == 0) {
+    key->inode = static_cast<quint64>(st.st_ino);
+  }
+  return true;
+}
+
+QString getIndexCacheFileName(const QString& cacheDirectory,
+                              const IndexCacheKey& key) {
+  auto hash =
+      QCryptographicHash::hash(key.path.toUtf8(), QCryptographicHash::Sha1);
+  return QDir(cacheDirectory)
+      .filePath(QString::fromLatin1(hash.toHex()) + ".qaindex");
+}
+
+// Maps the error of a failed read on the given archive to our error codes.
+short getReadErrorCode(struct archive* inArchive) {
+  if (PASSWORD_NEEDED(inArchive)) {
+    return ArchivePasswordNeeded;
+  }
+  if (PASSWORD_INCORRECT(inArchive)) {
+    return ArchivePasswordIncorrect;
+  }
+  return ArchiveCorrupted;
+}
+
+// State shared by the threads of a parallel extraction.
+struct ParallelExtractionState {
+  std::atomic<bool> canceled{false};
+  std::atomic<int> error{NoError};
+  std::atomic<int> finishedWorkers{0};
+  std::atomic<int> extractedEntries{0};
+  std::atomic<qint64> bytesProcessed{0};
+  std::mutex mutex;
+  // Signaled by the workers whenever an entry is done and when they end.
+  std::condition_variable changed;
+  QString lastEntry;  // Guarded by mutex.
+  std::vector<IOReaderStatistics> readStatistics;  // One for each worker.
+  // Set by the worker owning an entry once it is extracted, only read
+  // after the workers are joined.
+  std::vector<char> extracted;
+};
+
+// Extracts the entries of the archive which are owned by the given worker.
+// Every worker reads the archive through its own file and libarchive
+// reader, so nothing but the state is shared between the workers.
+short extractPartition(const QString& archivePath,
+                       const QString& password,
+                       int blockSize,
+                       const IOReaderOptions& options,
+                       struct archive* outArchive,
+                       EntryPathRewriter* rewriter,
+                       const std::vector<int>& owners,
+                       int worker,
+                       ParallelExtractionState* state) {
+  // The file must outlive the reader which closes it.
+  QFile file(archivePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return CannotOpenArchive;
+  }
+
+  QSharedPointer<struct archive> inArchive(archive_read_new(),
+                                           ArchiveReadDestructor);
+  if (!inArchive) {
+    return NotEnoughMemory;
+  }
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+  if (!password.isEmpty()) {
+    archive_read_add_passphrase(inArchive.data(),
+                                password.toUtf8().constData());
+  }
+#else
+  (void)password;
+#endif
+  // The format was found by walking the headers, so only its reader is
+  // needed.
+  archive_read_support_format_zip(inArchive.data());
+  archive_read_support_filter_all(inArchive.data());
+  auto readerOptions = options;
+  readerOptions.statistics = &state->readStatistics[worker];
+  if (archiveReadOpenQIODevice(inArchive.data(), blockSize, &file,
+                               readerOptions)) {
+    return ArchiveReadError;
+  }
+
+  archive_entry* entry = nullptr;
+  const void* buff;
+  size_t size;
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+  int64_t offset;
+#else
+  off_t offset;
+#endif
+  // Stop right after the last entry of this worker.
+  auto end = owners.size();
+  while (end > 0 && owners[end - 1] != worker) {
+    --end;
+  }
+  for (size_t index = 0; index < end; ++index) {
+    int ret = archive_read_next_header(inArchive.data(), &entry);
+    if (ret == ARCHIVE_EOF) {
+      break;
+    }
+    if (ret != ARCHIVE_OK) {
+      return getReadErrorCode(inArchive.data());
+    }
+
+    // The data of entries which are not read is skipped by libarchive
+    // on the next header.
+    if (owners[index] != worker) {
+      continue;
+    }
+
+    if (rewriter->rewrite(entry)) {
+      if (archive_write_header(outArchive, entry) != ARCHIVE_OK) {
+        return ArchiveHeaderWriteError;
+      }
+      for (;;) {
+        ret = archive_read_data_block(inArchive.data(), &buff, &size, &offset);
+        if (ret == ARCHIVE_EOF) {
+          break;
+        }
+        if (ret != ARCHIVE_OK) {
+          return getReadErrorCode(inArchive.data());
+        }
+        if (archive_write_data_block(outArchive, buff, size, offset) !=
+            ARCHIVE_OK) {
+          return ArchiveWriteError;
+        }
+        state->bytesProcessed += size;
+        if (state->canceled) {
+          return OperationCanceled;
+        }
+      }
+      if (archive_write_finish_entry(outArchive) == ARCHIVE_FATAL) {
+        return ArchiveHeaderWriteError;
+      }
+
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->lastEntry = QString::fromUtf8(archive_entry_pathname(entry));
+    }
+    state->extracted[index] = 1;
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      ++state->extractedEntries;
+    }
+    state->changed.notify_one();
+    if (state->canceled) {
+      return OperationCanceled;
+    }
+  }
+  return NoError;
+}
+
+// Reserves the size the header of the entry gives for the buffer it is
+// extracted to, so that the buffer is allocated once instead of growing
+// with every block. Sizes a QByteArray can't hold are left to grow.
+void reserveEntryBuffer(QBuffer* buffer, archive_entry* entry) {
+  if (!archive_entry_size_is_set(entry)) {
+    return;
+  }
+  const qint64 size = archive_entry_size(entry);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+  const qint64 maxSize = std::numeric_limits<qsizetype>::max() / 2;
+#else
+  const qint64 maxSize = std::numeric_limits<int>::max() / 2;
+#endif
+  if (size <= 0 || size > maxSize) {
+    return;
+  }
+  buffer->buffer().reserve(size);
+}
+
+// Writes a block to the buffer of an entry being extracted to memory. Blocks
+// come in order for almost all formats, these are appended to the data
+// directly. Sparse entries seek, which fills the holes with zeros.
+bool writeEntryBlock(QBuffer* buffer, const char* data, qint64 size,
+                     qint64 offset) {
+  QByteArray& bytes = buffer->buffer();
+  if (offset == bytes.size()) {
+    bytes.append(data, static_cast<decltype(bytes.size())>(size));
+    return true;
+  }
+  return buffer->seek(offset) && buffer->write(data, size) != -1;
+}
+
+// Writes a block to a device given by the entry device factory. Sequential
+// devices can't seek, the holes of sparse entries are written as zeros to
+// them instead.
+bool writeDeviceBlock(QIODevice* device, const char* data, qint64 size,
+                      qint64 offset, qint64* written) {
+  if (offset != *written) {
+    if (!device->isSequential()) {
+      if (!device->seek(offset)) {
+        return false;
+      }
+    } else if (offset > *written) {
+      const QByteArray zeros(static_cast<int>(qMin<qint64>(
+                                 offset - *written, 1 << 16)),
+                             '\0');
+      while (*written < offset) {
+        const qint64 n = qMin<qint64>(offset - *written, zeros.size());
+        if (device->write(zeros.constData(), n) != n) {
+          return false;
+        }
+        *written += n;
+      }
+    } else {
+      return false;
+    }
+  }
+  if (device->write(data, size) != size) {
+    return false;
+  }
+  *written = offset + size;
+  return true;
+}
+
+// Finds the format of the archive from its first bytes without consuming
+// them. Compressed streams are taken as compressed tar archives, like
+// the formats the compressor writes. AnyFormat if nothing matched.
+short detectArchiveFormat(QIODevice* device) {
+  if (!device) {
+    return AnyFormat;
+  }
+  // The tar magic is the furthest one from the start.
+  const QByteArray head = device->peek(262);
+  if (head.startsWith(QByteArray("7z\xBC\xAF\x27\x1C", 6))) {
+    return SevenZipFormat;
+  }
+  if (head.startsWith("PK\x03\x04") || head.startsWith("PK\x05\x06") ||
+      head.startsWith("PK\x07\x08")) {
+    return ZipFormat;
+  }
+  if (head.startsWith("xar!")) {
+    return XarFormat;
+  }
+  if (head.startsWith("\x1F\x8B")) {
+    return GZipFormat;
+  }
+  if (head.startsWith("BZh")) {
+    return BZip2Format;
+  }
+  if (head.startsWith(QByteArray("\xFD" "7zXZ\x00", 6))) {
+    return XzFormat;
+  }
+  if (head.startsWith("\x28\xB5\x2F\xFD")) {
+    return ZstdFormat;
+  }
+  if (head.mid(257, 5) == "ustar") {
+    return TarFormat;
+  }
+  return AnyFormat;
+}
 }  // namespace
 
 // ExtractorPrivate constructor constructs the object which is the private class
@@ -266,7 +877,8 @@ void ExtractorPrivate::setArchive(const QString& archivePath) {
   m_ArchivePath = archivePath;
 }
 
-// Blocksize to be used when extracting the given archive.
+// Blocksize to be used when reading the given archive, 0 picks one from
+// the kind of device the archive is read from.
 void ExtractorPrivate::setBlockSize(int n) {
   if (b_Started || b_Paused) {
     return;
@@ -288,6 +900,19 @@ void ExtractorPrivate::setCalculateProgress(bool c) {
   b_NoProgress = !c;
 }
 
+// Sets how the progress is calculated when progress is enabled,
+// InputProgress avoids the extra pass over the archive that
+// EntryProgress needs to count the entries.
+void ExtractorPrivate::setProgressMode(short mode) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  if (mode != EntryProgress && mode != InputProgress) {
+    return;
+  }
+  m_ProgressMode = mode;
+}
+
 // Sets the password for the archive when extracting the data.
 // This method should be accessible even if the extractor is started
 // since the user may set password anytime.
@@ -383,19 +1008,174 @@ void ExtractorPrivate::setRawOutputFilename(const QString& name) {
   b_RawMode = !name.isEmpty();
 }
 
+// Sets the directory where the entry index of archives given by path
+// are cached, so repeated getInfo() calls and progress calculation
+// on unchanged archives do not have to walk the archive again.
+// This is not cleared by clear() since it's meant to be set once and
+// used across archives.
+void ExtractorPrivate::setIndexCacheDirectory(const QString& path) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  m_IndexCacheDirectory = path;
+}
+
+// Sets the number of threads used to extract ZIP archives given by path to
+// the disk and to decompress BGZF and multi-frame zstd input, 0 uses one
+// thread per core.
+// This is not cleared by clear().
+void ExtractorPrivate::setThreads(int n) {
+  if (b_Started || b_Paused || n < 0) {
+    return;
+  }
+  n_Threads = n;
+}
+
+// Sets how often the event loop is processed while extracting, in
+// milliseconds. Pause and cancel requests do not depend on it.
+// This is not cleared by clear().
+void ExtractorPrivate::setProcessEventsInterval(int ms) {
+  m_EventPump.setInterval(ms);
+}
+
+// Emits progress at most once every given milliseconds, 0 disables the
+// limit. The progress at the end of the extraction is always emitted.
+// This and the other progress limits are not cleared by clear().
+void ExtractorPrivate::setProgressInterval(int ms) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  m_ProgressThrottle.setInterval(ms);
+}
+
+// Emits progress only after at least the given bytes were processed since
+// the last emitted progress, 0 disables the limit.
+void ExtractorPrivate::setProgressMinimumBytes(qint64 bytes) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  m_ProgressThrottle.setMinimumBytes(bytes);
+}
+
+// Emits progress only when an entry is fully extracted instead of after
+// every block.
+void ExtractorPrivate::setProgressPerEntryOnly(bool enabled) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  m_ProgressThrottle.setPerEntryOnly(enabled);
+}
+
+// Reads the given number of blocks of the archive ahead in a thread of its
+// own while libarchive works on the current one, 0 disables it. Files are
+// read instead of mapped then. Not cleared by clear().
+void ExtractorPrivate::setReadAhead(int blocks) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  n_ReadAheadBlocks = qMax(blocks, 0);
+}
+
+// Follows an archive which is still being written: when the reader gets to
+// the current end of the archive it waits up to the given milliseconds for
+// more data before taking it as the end. Only formats which can be streamed
+// can be followed. 0 disables it. Not cleared by clear().
+void ExtractorPrivate::setFollowTimeout(int ms) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  n_FollowTimeout = qMax(ms, 0);
+}
+
+// Waits up to the given milliseconds for more data of a sequential archive
+// before failing with ArchiveReadTimeout, -1 waits until the device ends.
+// A cancel stops the wait. Not cleared by clear().
+void ExtractorPrivate::setSequentialTimeout(int ms) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  n_SequentialTimeout = qMax(ms, -1);
+}
+
+// Caches up to the given number of blocks of the archive, so that the seeks
+// of 7-Zip and ZIP archives on slow storage are served from memory. The
+// hits and misses are given by the statistics signal. 0 disables it. Not
+// cleared by clear().
+void ExtractorPrivate::setBlockCache(int blocks) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  n_CacheBlocks = qMax(blocks, 0);
+}
+
+// Only enables the libarchive readers needed for the given format instead
+// of all of them, which saves registering and bidding every reader on each
+// open. AutoFormat looks at the first bytes of the archive once to pick
+// the format, AnyFormat enables everything. Not cleared by clear().
+void ExtractorPrivate::setArchiveFormat(short format) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  if (format != AnyFormat && format != AutoFormat &&
+      (format < TarFormat || format > ZstdFormat)) {
+    return;
+  }
+  n_ArchiveFormat = format;
+  n_DetectedFormat = 0;
+}
+
+// Options for the readers of the archive.
+IOReaderOptions ExtractorPrivate::getReaderOptions() const {
+  IOReaderOptions options;
+  options.dropPageCache = b_DropPageCache;
+  options.readAheadBlocks = n_ReadAheadBlocks;
+  // The archive is complete once a read of it got to the end, it is not
+  // followed again.
+  options.followTimeout = b_FollowedToEnd ? 0 : n_FollowTimeout;
+  options.sequentialTimeout = n_SequentialTimeout;
+  options.cacheBlocks = n_CacheBlocks;
+  options.cancelRequested = &b_CancelRequested;
+  options.pauseRequested = &b_PauseRequested;
+  return options;
+}
+
+// Drops the pages of the archive from the page cache once they were read.
+// Files are read instead of mapped then. Not cleared by clear().
+void ExtractorPrivate::setDropPageCache(bool enabled) {
+  if (b_Started || b_Paused) {
+    return;
+  }
+  b_DropPageCache = enabled;
+}
+
+// Extracts each entry to the device the given factory returns for it
+// instead of keeping it in memory, in memory mode only. The factory is
+// called from the thread of the extractor with the information of the
+// entry and may return nullptr to skip it. The device is opened for
+// writing if it isn't open and it is closed once the entry is written,
+// it is never deleted. The factory is not cleared by clear().
+void ExtractorPrivate::setEntryDeviceFactory(EntryDeviceFactory factory) {
+  if (!b_MemoryMode || b_Started || b_Paused) {
+    return;
+  }
+  m_EntryDeviceFactory = std::move(factory);
+}
+
 // Clears all internal data and sets it back to default.
 void ExtractorPrivate::clear() {
   if (b_Started) {
     return;
   }
-  n_BlockSize = 10240;
+  n_BlockSize = 0;
   n_PasswordTriedCountGetInfo = n_PasswordTriedCountExtract = 0;
   n_TotalEntries = -1;
   b_RawMode = b_ProcessingArchive = b_StartRequested = false;
+  n_DetectedFormat = 0;
   b_PauseRequested = b_CancelRequested = b_Paused = b_Started = b_Finished =
-      b_ArchiveOpened = false;
+      b_ArchiveOpened = b_SequentialConsumed = b_FollowedToEnd = false;
 
   n_BytesTotal = 0;
+  n_InputBytesTotal = 0;
 
   m_ArchivePath.clear();
 #if ARCHIVE_VERSION_NUMBER >= 3003003
@@ -405,8 +1185,12 @@ void ExtractorPrivate::clear() {
   m_RawOutputFilename.clear();
   m_ArchiveRead.clear();
   m_ArchiveWrite.clear();
+  m_ParallelFilter.reset();
   m_Info = {};
+  m_Index.clear();
   m_ExtractFilters.clear();
+  clearExtractEntries();
+  m_EntriesDone.clear();
 #ifdef __cpp_lib_make_unique
   m_archiveFilter = std::make_unique<ArchiveFilter>();
 #else
@@ -428,6 +1212,10 @@ void ExtractorPrivate::clear() {
     m_Archive = nullptr;
   }
   m_CurrentArchiveEntry = nullptr;
+  if (m_CurrentEntryDevice) {
+    m_CurrentEntryDevice->close();
+    m_CurrentEntryDevice = nullptr;
+  }
   b_QIODeviceOwned = false;
 }
 
@@ -438,10 +1226,15 @@ void ExtractorPrivate::getInfo() {
   }
 
   b_ProcessingArchive = true;
+  m_ReadStatistics = IOReaderStatistics();
 
-  if (!m_Info.empty()) {
+  if (!m_Index.empty() || loadIndexCache()) {
+    if (m_Info.empty()) {
+      buildInfoFromIndex();
+    }
     b_ProcessingArchive = false;
     emit info(m_Info);
+    emitStatistics();
     if (b_StartRequested) {
       b_StartRequested = false;
       start();
@@ -463,9 +1256,12 @@ void ExtractorPrivate::getInfo() {
 
   errorCode = processArchiveInformation();
   b_ProcessingArchive = false;
+  b_SequentialConsumed = m_Archive->isSequential();
 
   if (!errorCode) {
+    saveIndexCache();
     emit info(m_Info);
+    emitStatistics();
   }
 #if ARCHIVE_VERSION_NUMBER >= 3003003
   else if (errorCode == ArchivePasswordIncorrect ||
@@ -495,29 +1291,72 @@ void ExtractorPrivate::start() {
   // Open the Archive.
   short errorCode = openArchive();
   if (errorCode != NoError) {
+    clearExtractEntries();
     emit error(errorCode);
     return;
   }
 
+  // getInfo() already read a sequential archive through, there is nothing
+  // left of it to extract.
+  if (b_SequentialConsumed) {
+    clearExtractEntries();
+    emit error(IODeviceSequential);
+    return;
+  }
+
   // Check and Set Output Directory.
   // If it's not memory mode.
   if (!b_MemoryMode && !m_OutputDirectory.isEmpty()) {
     errorCode = checkOutputDirectory();
     if (errorCode != NoError) {
+      clearExtractEntries();
       emit error(errorCode);
       return;
     }
   }
 
+  // Compile the filters once for all the entries.
+  const auto& filters =
+      b_ExtractEntriesOnly ? m_ExtractEntries : m_ExtractFilters;
+#ifdef __cpp_lib_make_unique
+  m_ExtractFilter =
+      std::make_unique<ExtractFilter>(filters, m_archiveFilter.get());
+#else
+  m_ExtractFilter.reset(new ExtractFilter(filters, m_archiveFilter.get()));
+#endif
+
   // All Okay then start the extraction.
+  // Requests made before this point are for an earlier extraction.
+  b_PauseRequested = b_CancelRequested = false;
+  m_EntriesDone.clear();
+  m_ProgressThrottle.reset();
+  n_DecompressionThreads = 1;
   b_Started = true;
   b_Finished = false;
   emit started();
 
   // Get basic information about the archive if the user wants progress on the
   // extraction.
-  if (n_TotalEntries == -1 && !b_NoProgress) {
-    errorCode = getTotalEntriesCount();
+  //
+  // Sequential and followed archives can only be read once, they are
+  // extracted without totals and the progress is given for every entry only.
+  const bool sequential = m_Archive->isSequential() || n_FollowTimeout > 0;
+  if (!b_NoProgress && m_ProgressMode == InputProgress) {
+    // The progress is calculated from the archive input consumed while
+    // extracting, so there is no need to walk the archive beforehand.
+    n_InputBytesTotal = sequential ? 0 : m_Archive->size();
+  } else if (n_TotalEntries == -1 && !b_NoProgress && !b_ExtractEntriesOnly &&
+             !sequential && !loadIndexCache()) {
+    // When the index is cached, collect the full information instead
+    // of just the count so the next extraction of this archive is free.
+    if (m_IndexCacheDirectory.isEmpty()) {
+      errorCode = getTotalEntriesCount();
+    } else if ((errorCode = processArchiveInformation()) == NoError) {
+      saveIndexCache();
+    } else {
+      m_Info = {};
+      m_Index.clear();
+    }
     if (n_TotalEntries == -1) {
       // If the total entries is unchanged then there must be an
       // error.
@@ -534,11 +1373,17 @@ void ExtractorPrivate::start() {
     }
   }
 
+  // The statistics are of the extraction, not of listing the archive.
+  m_ReadStatistics = IOReaderStatistics();
   errorCode = extract();
+  if (errorCode != OperationPaused) {
+    clearExtractEntries();
+  }
   if (errorCode == NoError) {
     b_Started = false;
     b_Finished = true;
     m_Archive->close();
+    emitStatistics();
     if (!b_MemoryMode) {
       emit diskFinished();
     } else {
@@ -573,6 +1418,37 @@ void ExtractorPrivate::start() {
   }
 }
 
+// Extracts only the entry with the given path in the archive.
+void ExtractorPrivate::extractEntry(const QString& path) {
+  extractEntries(QStringList() << path);
+}
+
+// Extracts only the entries with the given paths in the archive, in place
+// of the extract filters for this extraction only. Unlike filters, the
+// archive is only read up to the last of the given entries. The ZIP reader
+// finds the entries through the central directory and skips the data in
+// between, the 7-Zip reader does not since it has to decompress a solid
+// block up to the entry. With a known index the paths not in the archive
+// are not searched for, and a tar archive without a filter is read from
+// the header of the first given entry.
+void ExtractorPrivate::extractEntries(const QStringList& paths) {
+  if (b_Started || b_Paused || paths.isEmpty()) {
+    return;
+  }
+  m_ExtractEntries = paths;
+  m_ExtractEntries.removeDuplicates();
+  b_ExtractEntriesOnly = true;
+  start();
+}
+
+// Ends an extraction started by extractEntries(), the next one extracts by
+// the filters again.
+void ExtractorPrivate::clearExtractEntries() {
+  b_ExtractEntriesOnly = false;
+  m_ExtractEntries.clear();
+  m_PendingEntries.clear();
+}
+
 // Pauses the extractor.
 void ExtractorPrivate::pause() {
   if (b_Started && !b_Paused) {
@@ -586,14 +1462,19 @@ void ExtractorPrivate::resume() {
     return;
   }
   b_Paused = false;
+  b_PauseRequested = b_CancelRequested = false;
   b_Started = true;
   emit resumed();
 
   short ret = extract();
+  if (ret != OperationPaused) {
+    clearExtractEntries();
+  }
   if (ret == NoError) {
     b_Started = false;
     b_Finished = true;
     m_Archive->close();
+    emitStatistics();
     if (!b_MemoryMode) {
       emit diskFinished();
     } else {
@@ -627,6 +1508,19 @@ void ExtractorPrivate::resume() {
   }
 }
 
+// Requests the running extraction to pause, unlike pause() this can be
+// called from any thread. The request is dropped when an extraction starts
+// or resumes, the queued pause() covers an extraction which is yet to
+// start.
+void ExtractorPrivate::requestPause() {
+  b_PauseRequested = true;
+}
+
+// Requests the running extraction to cancel, can be called from any thread.
+void ExtractorPrivate::requestCancel() {
+  b_CancelRequested = true;
+}
+
 // Cancels the extraction.
 void ExtractorPrivate::cancel() {
   if (b_Started && !b_Paused && !b_Finished) {
@@ -718,6 +1612,33 @@ short ExtractorPrivate::extract() {
   archive_entry* entry = nullptr;
 
   if (!m_ArchiveRead && (b_MemoryMode || !m_ArchiveWrite)) {
+    if (b_ExtractEntriesOnly) {
+      m_PendingEntries.clear();
+      QSet<QByteArray> requested;
+      for (const auto& path : m_ExtractEntries) {
+        requested.insert(path.toUtf8());
+      }
+      if (m_Index.empty() && !loadIndexCache()) {
+        m_PendingEntries = requested;
+      } else {
+        for (const auto& indexEntry : m_Index) {
+          if (requested.contains(indexEntry.pathname)) {
+            m_PendingEntries.insert(indexEntry.pathname);
+          }
+        }
+      }
+      if (m_PendingEntries.isEmpty()) {
+        // None of the entries are in the archive.
+        return NoError;
+      }
+    }
+
+    bool handled = false;
+    err = extractParallel(&handled);
+    if (err != NoError || handled) {
+      return err;
+    }
+
     n_ProcessedEntries = 0;
     n_BytesProcessed = 0;
 
@@ -742,13 +1663,53 @@ short ExtractorPrivate::extract() {
                                   m_Password.toUtf8().constData());
     }
 #endif
-    toggleArchiveFormat(m_ArchiveRead.data());
-    archive_read_support_filter_all(m_ArchiveRead.data());
+    const qint64 startPosition = indexedStartPosition();
+    if (startPosition > 0) {
+      archive_read_support_format_tar(m_ArchiveRead.data());
+    } else {
+      toggleArchiveFormat(m_ArchiveRead.data());
+    }
 
-    if (archiveReadOpenQIODevice(m_ArchiveRead.data(), n_BlockSize,
-                                 m_Archive)) {
+    // gzip streams made of BGZF members and zstd streams made of several
+    // frames are decompressed on n_Threads threads, libarchive then only
+    // reads the archive in them.
+    QIODevice* input = m_Archive;
+    m_ParallelFilter.reset();
+    n_DecompressionThreads = 1;
+    const int threads =
+        n_Threads > 0 ? n_Threads : QThread::idealThreadCount();
+    if (threads > 1 && n_FollowTimeout == 0 && startPosition <= 0) {
+      if (auto format = ParallelFilterReader::detect(m_Archive)) {
+        m_ParallelFilter.reset(
+            new ParallelFilterReader(m_Archive, format, threads));
+        input = m_ParallelFilter.get();
+        n_DecompressionThreads = threads;
+      }
+    }
+
+    // The reader starts at the position of the device, a tar archive can
+    // be read from any of its headers. Should the seek fail the archive is
+    // read from the start, which works the same.
+    if (startPosition > 0) {
+      m_Archive->seek(startPosition);
+    }
+
+    auto readerOptions = getReaderOptions();
+    readerOptions.statistics = &m_ReadStatistics;
+    if (archiveReadOpenQIODevice(m_ArchiveRead.data(), n_BlockSize, input,
+                                 readerOptions)) {
       m_ArchiveRead.clear();
       m_ArchiveWrite.clear();
+      m_ParallelFilter.reset();
+      // Opening reads the start of the archive, which may have been waited
+      // on when the cancel came.
+      if (b_CancelRequested) {
+        b_CancelRequested = false;
+        return OperationCanceled;
+      }
+      if (m_ReadStatistics.timedOut) {
+        return ArchiveReadTimeout;
+      }
       return ArchiveReadError;
     }
 
@@ -756,8 +1717,20 @@ short ExtractorPrivate::extract() {
         archive_write_disk_set_options(m_ArchiveWrite.data(), n_Flags)) {
       m_ArchiveRead.clear();
       m_ArchiveWrite.clear();
+      m_ParallelFilter.reset();
       return ArchiveWriteError;
     }
+
+    const auto& rawOutputFilename =
+        b_RawMode ? m_RawOutputFilename : QString();
+    const auto& basePath = b_hasBasePath ? m_basePath.path() : QString();
+#ifdef __cpp_lib_make_unique
+    m_PathRewriter = std::make_unique<EntryPathRewriter>(
+        b_MemoryMode, rawOutputFilename, basePath, m_OutputDirectory);
+#else
+    m_PathRewriter.reset(new EntryPathRewriter(
+        b_MemoryMode, rawOutputFilename, basePath, m_OutputDirectory));
+#endif
   }
 
   if (m_CurrentArchiveEntry) {
@@ -768,40 +1741,45 @@ short ExtractorPrivate::extract() {
     if (err) {  // NoError = 0
       m_ArchiveRead.clear();
       m_ArchiveWrite.clear();
+      m_ParallelFilter.reset();
       return err;
     }
     ++n_ProcessedEntries;
 
     // Report final progress signal after extracting the file fully.
-    if (n_BytesTotal > 0 && n_TotalEntries > 0) {
-      emit progress(archive_entry_pathname(m_CurrentArchiveEntry),
-                    n_ProcessedEntries, n_TotalEntries, n_BytesProcessed,
-                    n_BytesTotal);
-    } else {
-      emit progress(archive_entry_pathname(m_CurrentArchiveEntry), 1, 1, 1, 1);
-    }
+    reportProgress(archive_entry_pathname(m_CurrentArchiveEntry),
+                   /*entryDone=*/true);
 
     archive_entry_clear(m_CurrentArchiveEntry);
     m_CurrentArchiveEntry = nullptr;
   }
 
-  for (;;) {
+  while (!b_ExtractEntriesOnly || !m_PendingEntries.isEmpty()) {
     ret = archive_read_next_header(m_ArchiveRead.data(), &entry);
     if (ret == ARCHIVE_EOF) {
+      b_FollowedToEnd = n_FollowTimeout > 0;
       break;
     }
     if (ret != ARCHIVE_OK) {
-      err = ArchiveCorrupted;
-      if (PASSWORD_NEEDED(m_ArchiveRead.data())) {
-        err = ArchivePasswordNeeded;
-      } else if (PASSWORD_INCORRECT(m_ArchiveRead.data())) {
-        err = ArchivePasswordIncorrect;
-      }
+      err = readError(m_ArchiveRead.data());
       m_ArchiveRead.clear();
       m_ArchiveWrite.clear();
+      m_ParallelFilter.reset();
       return err;
     }
 
+    // Skip the entries done before a pause which needs the archive to be
+    // read again.
+    if (n_ProcessedEntries < static_cast<int>(m_EntriesDone.size()) &&
+        m_EntriesDone[n_ProcessedEntries]) {
+      if (b_ExtractEntriesOnly) {
+        m_PendingEntries.remove(archive_entry_pathname(entry));
+      }
+      n_BytesProcessed += archive_entry_size(entry);
+      ++n_ProcessedEntries;
+      continue;
+    }
+
     err = writeData(entry);
     if (err == OperationPaused) {
       return err;
@@ -809,34 +1787,390 @@ short ExtractorPrivate::extract() {
     if (err) {  // NoError = 0
       m_ArchiveRead.clear();
       m_ArchiveWrite.clear();
+      m_ParallelFilter.reset();
       return err;
     }
     ++n_ProcessedEntries;
 
     // Report final progress signal after extracting the file fully.
-    if (n_BytesTotal > 0 && n_TotalEntries > 0) {
-      emit progress(archive_entry_pathname(entry), n_ProcessedEntries,
-                    n_TotalEntries, n_BytesProcessed, n_BytesTotal);
-    } else {
-      emit progress(archive_entry_pathname(entry), 1, 1, 1, 1);
-    }
+    reportProgress(archive_entry_pathname(entry), /*entryDone=*/true);
     archive_entry_clear(entry);
-    QCoreApplication::
-        processEvents();  // call event loop for the signal to take effect.
+    m_EventPump.pump();  // call event loop for the signal to take effect.
   }
+  flushProgress();
 
   /* free memory. */
   m_ArchiveRead.clear();
   m_ArchiveWrite.clear();
+  m_ParallelFilter.reset();
   return NoError;
 }
 
+// Extracts the archive with n_Threads threads, each extracting its own
+// share of the entries through its own reader and disk writer.
+// This is only done for ZIP archives given by path which are extracted to
+// the disk, for anything else handled is set to false and the archive has
+// to be extracted by extract() as usual. 7-Zip archives are left out since
+// libarchive does not tell which entries share a solid block, and reaching
+// an entry of a solid block means decompressing the entries before it.
+// The workers cannot be paused, a pause stops them and the entries they
+// did not finish are extracted by extract() on resume.
+short ExtractorPrivate::extractParallel(bool* handled) {
+  *handled = false;
+  int threads = n_Threads > 0 ? n_Threads : QThread::idealThreadCount();
+  if (threads < 2 || b_MemoryMode || b_RawMode || m_ArchivePath.isEmpty() ||
+      n_FollowTimeout > 0 || !m_EntriesDone.empty()) {
+    return NoError;
+  }
+
+  // Walk the headers once to find the format and the entries to extract,
+  // the ZIP reader seeks over the entry data so this is cheap compared to
+  // the extraction itself.
+  std::vector<qint64> sizes;  // -1 if the entry is not extracted.
+  int skippedEntries = 0;
+  qint64 skippedBytes = 0;
+  qint64 extractedBytes = 0;
+  {
+    QSharedPointer<struct archive> inArchive(archive_read_new(),
+                                             ArchiveReadDestructor);
+    if (!inArchive) {
+      return NotEnoughMemory;
+    }
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+    if (!m_Password.isEmpty()) {
+      archive_read_add_passphrase(inArchive.data(),
+                                  m_Password.toUtf8().constData());
+    }
+#endif
+    toggleArchiveFormat(inArchive.data());
+    if (archiveReadOpenQIODevice(inArchive.data(), n_BlockSize, m_Archive,
+                                 getReaderOptions())) {
+      return ArchiveReadError;
+    }
+
+    auto pendingEntries = m_PendingEntries;
+    archive_entry* entry = nullptr;
+    while (!b_ExtractEntriesOnly || !pendingEntries.isEmpty()) {
+      int ret = archive_read_next_header(inArchive.data(), &entry);
+      if (ret == ARCHIVE_EOF) {
+        break;
+      }
+      if (ret != ARCHIVE_OK) {
+        *handled = true;
+        return getReadErrorCode(inArchive.data());
+      }
+      if (sizes.empty() && (archive_format(inArchive.data()) &
+                            ARCHIVE_FORMAT_BASE_MASK) != ARCHIVE_FORMAT_ZIP) {
+        return NoError;
+      }
+
+      if (b_ExtractEntriesOnly) {
+        pendingEntries.remove(archive_entry_pathname(entry));
+      }
+      auto size = archive_entry_size(entry);
+      if (isEntryExtracted(entry)) {
+        sizes.push_back(size);
+        extractedBytes += size;
+      } else {
+        sizes.push_back(-1);
+        ++skippedEntries;
+        skippedBytes += size;
+      }
+    }
+  }
+
+  int extractedEntries = static_cast<int>(sizes.size()) - skippedEntries;
+  if (extractedEntries < 2) {
+    return NoError;
+  }
+  threads = qMin(threads, extractedEntries);
+
+  // Partition the entries into contiguous runs balanced by their size, so
+  // that every thread stops walking the headers at the end of its own run
+  // instead of near the end of the archive. An entry starts the next run
+  // once its middle is past the share of the current one. Every entry
+  // weighs one more byte so that empty entries are spread too.
+  std::vector<int> owners(sizes.size(), -1);
+  const qint64 totalWeight = extractedBytes + extractedEntries;
+  qint64 weight = 0;
+  int owner = 0;
+  for (size_t index = 0; index < sizes.size(); ++index) {
+    if (sizes[index] < 0) {
+      continue;
+    }
+    const qint64 entryWeight = sizes[index] + 1;
+    if (weight > 0 && owner < threads - 1 &&
+        (weight + entryWeight / 2) * threads > totalWeight * (owner + 1)) {
+      ++owner;
+    }
+    owners[index] = owner;
+    weight += entryWeight;
+  }
+
+  *handled = true;
+  n_ProcessedEntries = skippedEntries;
+  n_BytesProcessed = skippedBytes;
+  const int totalEntries = static_cast<int>(sizes.size());
+  const qint64 totalBytes = skippedBytes + extractedBytes;
+
+  const auto archivePath = m_ArchivePath;
+  const auto password = m_Password;
+  const auto blockSize = n_BlockSize;
+  const auto readerOptions = getReaderOptions();
+  const auto basePath = b_hasBasePath ? m_basePath.path() : QString();
+  const auto outputDirectory = m_OutputDirectory;
+
+  ParallelExtractionState state;
+  state.readStatistics.resize(threads);
+  state.extracted.resize(sizes.size(), 0);
+  std::vector<QSharedPointer<struct archive>> outArchives;
+  std::vector<std::thread> workers;
+  short err = NoError;
+  for (int worker = 0; worker < threads; ++worker) {
+    QSharedPointer<struct archive> outArchive(archive_write_disk_new(),
+                                              ArchiveWriteDestructor);
+    if (!outArchive) {
+      err = NotEnoughMemory;
+      break;
+    }
+    if (archive_write_disk_set_options(outArchive.data(), n_Flags)) {
+      err = ArchiveWriteError;
+      break;
+    }
+    outArchives.push_back(outArchive);
+
+    auto writer = outArchive.data();
+    workers.emplace_back([&, worker, writer]() {
+      EntryPathRewriter rewriter(false, QString(), basePath, outputDirectory);
+      auto ret =
+          extractPartition(archivePath, password, blockSize, readerOptions,
+                           writer, &rewriter, owners, worker, &state);
+      if (ret != NoError && ret != OperationCanceled) {
+        int expected = NoError;
+        state.error.compare_exchange_strong(expected, ret);
+        state.canceled = true;
+      }
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        ++state.finishedWorkers;
+      }
+      state.changed.notify_one();
+    });
+  }
+  if (err != NoError) {
+    state.canceled = true;
+  }
+
+  auto reportParallelProgress = [&]() {
+    QString lastEntry;
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      lastEntry = state.lastEntry;
+    }
+    n_ProcessedEntries = skippedEntries + state.extractedEntries;
+    n_BytesProcessed = skippedBytes + state.bytesProcessed;
+    emit progress(lastEntry, n_ProcessedEntries, totalEntries,
+                  n_BytesProcessed, totalBytes);
+  };
+
+  // Wait for the workers to finish entries, waking up at least once every
+  // event loop interval to process the events and see pause and cancel
+  // requests. With no interval the events are processed every 10 ms.
+  const auto timeout = std::chrono::milliseconds(
+      m_EventPump.interval() > 0 ? m_EventPump.interval() : 10);
+  const int workerCount = static_cast<int>(workers.size());
+  int reportedEntries = 0;
+  int seenEntries = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(state.mutex);
+      state.changed.wait_for(lock, timeout, [&]() {
+        return state.extractedEntries != seenEntries ||
+               state.finishedWorkers == workerCount;
+      });
+      if (state.finishedWorkers == workerCount) {
+        break;
+      }
+      seenEntries = state.extractedEntries;
+    }
+    m_EventPump.pump();
+
+    // A pause stops the workers like a cancel, telling them apart once
+    // they are joined.
+    if (b_CancelRequested || b_PauseRequested) {
+      state.canceled = true;
+    }
+
+    if (state.extractedEntries != reportedEntries &&
+        m_ProgressThrottle.pass(skippedBytes + state.bytesProcessed, true)) {
+      reportedEntries = state.extractedEntries;
+      reportParallelProgress();
+    }
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  // Closing the writers restores the times and permissions of the
+  // directories, which has to wait until all threads are done with them.
+  outArchives.clear();
+
+  m_ReadStatistics = IOReaderStatistics();
+  for (const auto& statistics : state.readStatistics) {
+    m_ReadStatistics.blockSize = statistics.blockSize;
+    m_ReadStatistics.memoryBacked = statistics.memoryBacked;
+    m_ReadStatistics.reads += statistics.reads;
+    m_ReadStatistics.bytesRead += statistics.bytesRead;
+    m_ReadStatistics.cacheHits += statistics.cacheHits;
+    m_ReadStatistics.cacheMisses += statistics.cacheMisses;
+    m_ReadStatistics.skips += statistics.skips;
+    m_ReadStatistics.bytesSkipped += statistics.bytesSkipped;
+  }
+
+  if (state.extractedEntries != reportedEntries) {
+    reportParallelProgress();
+  }
+  if (err == NoError) {
+    err = static_cast<short>(state.error.load());
+  }
+  // Without an error, the only way to leave entries behind is a cancel or
+  // a pause. The entries left are extracted by extract() on resume, which
+  // skips the ones the workers are done with.
+  if (err == NoError && state.extractedEntries != extractedEntries) {
+    if (!b_CancelRequested && b_PauseRequested) {
+      b_PauseRequested = false;
+      m_EntriesDone = std::move(state.extracted);
+      return OperationPaused;
+    }
+    err = OperationCanceled;
+  }
+  b_CancelRequested = false;
+  return err;
+}
+
+// Emits the progress for the given entry, entryDone is set when the
+// entry is fully extracted so that a signal is emitted for every entry
+// even if the progress is not calculated.
+// Updates held back by the progress throttle are emitted by
+// flushProgress() at the end, force skips the throttle.
+void ExtractorPrivate::reportProgress(const char* pathname,
+                                      bool entryDone,
+                                      bool force) {
+  int processedEntries = 1;
+  int totalEntries = 1;
+  qint64 bytesProcessed = 1;
+  qint64 bytesTotal = 1;
+  if (!b_NoProgress && m_ProgressMode == InputProgress &&
+      n_InputBytesTotal > 0) {
+    // The last filter is the one reading our QIODevice, so this is the
+    // amount of (compressed) input consumed so far, unless the input is
+    // decompressed before it gets there.
+    processedEntries = n_ProcessedEntries;
+    totalEntries = n_TotalEntries;
+    const qint64 consumed =
+        m_ParallelFilter ? m_ParallelFilter->inputPosition()
+                         : static_cast<qint64>(
+                               archive_filter_bytes(m_ArchiveRead.data(), -1));
+    bytesProcessed = qMin(consumed, n_InputBytesTotal);
+    bytesTotal = n_InputBytesTotal;
+  } else if (n_BytesTotal > 0 && n_TotalEntries > 0) {
+    processedEntries = n_ProcessedEntries;
+    totalEntries = n_TotalEntries;
+    bytesProcessed = n_BytesProcessed;
+    bytesTotal = n_BytesTotal;
+  } else if (!entryDone) {
+    return;
+  }
+
+  if (!force && !m_ProgressThrottle.pass(bytesProcessed, entryDone)) {
+    if (m_ProgressThrottle.hasPending()) {
+      m_PendingProgressEntry = pathname;
+    }
+    return;
+  }
+  emit progress(QString::fromUtf8(pathname), processedEntries, totalEntries,
+                bytesProcessed, bytesTotal);
+}
+
+// Emits the last progress update if it was held back by the throttle,
+// so the final progress is always reported.
+void ExtractorPrivate::flushProgress() {
+  if (m_ProgressThrottle.hasPending()) {
+    reportProgress(m_PendingProgressEntry.constData(), /*entryDone=*/true,
+                   /*force=*/true);
+    m_ProgressThrottle.reset();
+  }
+}
+
+// Enables the format and filter readers for the archive, all of them
+// unless a format was given by setArchiveFormat or found by AutoFormat.
 void ExtractorPrivate::toggleArchiveFormat(struct archive* inArchive) {
+  short format = n_ArchiveFormat;
+  if (format == AutoFormat) {
+    if (!n_DetectedFormat) {
+      n_DetectedFormat = detectArchiveFormat(m_Archive);
+    }
+    format = n_DetectedFormat;
+  }
+
   if (b_RawMode) {
     archive_read_support_format_raw(inArchive);
     archive_read_support_format_empty(inArchive);
   } else {
-    archive_read_support_format_all(inArchive);
+    switch (format) {
+      case ZipFormat:
+        archive_read_support_format_zip(inArchive);
+        break;
+      case SevenZipFormat:
+        archive_read_support_format_7zip(inArchive);
+        break;
+      case XarFormat:
+        archive_read_support_format_xar(inArchive);
+        break;
+      case ZstdFormat:
+        // The compressor writes ISO9660 with zstd in memory mode.
+        archive_read_support_format_iso9660(inArchive);
+        archive_read_support_format_tar(inArchive);
+        break;
+      case TarFormat:
+      case BZipFormat:
+      case BZip2Format:
+      case GZipFormat:
+      case XzFormat:
+        archive_read_support_format_tar(inArchive);
+        break;
+      default:
+        archive_read_support_format_all(inArchive);
+        break;
+    }
+  }
+
+  switch (format) {
+    case BZipFormat:
+    case BZip2Format:
+      archive_read_support_filter_bzip2(inArchive);
+      break;
+    case GZipFormat:
+      archive_read_support_filter_gzip(inArchive);
+      break;
+    case XzFormat:
+      archive_read_support_filter_xz(inArchive);
+      break;
+    case ZstdFormat:
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+      archive_read_support_filter_zstd(inArchive);
+#else
+      archive_read_support_filter_all(inArchive);
+#endif
+      break;
+    case TarFormat:
+    case ZipFormat:
+    case SevenZipFormat:
+    case XarFormat:
+      break;
+    default:
+      archive_read_support_filter_all(inArchive);
+      break;
   }
 }
 
@@ -845,39 +2179,6 @@ short ExtractorPrivate::writeData(struct archive_entry* entry) {
     return ArchiveNotGiven;
   }
 
-  if (!(m_ExtractFilters.empty() ||
-        m_ExtractFilters.contains(archive_entry_pathname(entry))) ||
-      m_archiveFilter->isEntryExcluded(entry)) {
-    n_BytesProcessed += archive_entry_size(entry);
-    return NoError;
-  }
-
-  if (!b_MemoryMode && b_RawMode && !m_RawOutputFilename.isEmpty()) {
-    const auto& path = (QFileInfo(archive_entry_pathname(entry)).path() +
-                        QString::fromUtf8("/") + m_RawOutputFilename)
-                           .toStdWString();
-    archive_entry_copy_pathname_w(entry, path.c_str());
-  }
-  if (b_hasBasePath) {
-    const auto& relativePath =
-        m_basePath
-            .relativeFilePath(QString::fromUtf8("/") +
-                              archive_entry_pathname(entry))
-            .toStdWString();
-    if (relativePath == L".") {  // Root directory
-      return NoError;
-    }
-    archive_entry_copy_pathname_w(entry, relativePath.c_str());
-  }
-  if (!b_MemoryMode && !m_OutputDirectory.isEmpty()) {
-    QDir outDir(m_OutputDirectory);
-    const auto& new_entry = outDir
-                                .absoluteFilePath(QString::fromStdWString(
-                                    archive_entry_pathname_w(entry)))
-                                .toStdWString();
-    archive_entry_copy_pathname_w(entry, new_entry.c_str());
-  }
-
   MutableMemoryFile currentNode;
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
   qsizetype ret = ARCHIVE_OK;
@@ -885,24 +2186,18 @@ short ExtractorPrivate::writeData(struct archive_entry* entry) {
   qptrdiff ret = ARCHIVE_OK;
 #endif
   if (m_CurrentArchiveEntry != entry) {
-    if (!b_MemoryMode) {
-      // UTF-8 in archive entry messes up when extracting under Windows
-      // when UTF-8 is not set, to fix this we first get the archive
-      // entry pathname in raw bytes then convert it to wide characters
-      // and set it has the new pathname which should make libarchive
-      // handle it better.
-
-      // Get current pathname
-      auto ptname_cstr = archive_entry_pathname(entry);
-
-      // Check if UTF-8
-      if (isUTF8(ptname_cstr)) {
-        auto ptname = QString::fromUtf8(ptname_cstr);
-
-        auto wstr = ptname.toStdWString();
-        archive_entry_copy_pathname_w(entry, wstr.c_str());
-      }
+    if (b_ExtractEntriesOnly) {
+      m_PendingEntries.remove(archive_entry_pathname(entry));
+    }
+    if (!isEntryExtracted(entry)) {
+      n_BytesProcessed += archive_entry_size(entry);
+      return NoError;
+    }
+    if (!m_PathRewriter->rewrite(entry)) {
+      return NoError;
+    }
 
+    if (!b_MemoryMode) {
       ret = archive_write_header(m_ArchiveWrite.data(), entry);
     } else {
       currentNode.setFileInformation(getArchiveEntryInformation(entry, false));
@@ -913,14 +2208,22 @@ short ExtractorPrivate::writeData(struct archive_entry* entry) {
         return NoError;
       }
 
+      /// Stream the entry to the device given by the factory if set.
+      if (m_EntryDeviceFactory) {
+        return writeDataToDevice(entry, currentNode.getFileInformation());
+      }
+
       currentNode.setBuffer(new QBuffer);
 
       if (!(currentNode.getBuffer())->open(QIODevice::ReadWrite)) {
         return ArchiveHeaderWriteError;
       }
+      reserveEntryBuffer(currentNode.getBuffer().get(), entry);
 
       m_CurrentMemoryFile = currentNode;
     }
+  } else if (m_CurrentEntryDevice) {
+    return writeDataToDevice(entry, QJsonObject());
   } else {
     currentNode = m_CurrentMemoryFile;
   }
@@ -941,12 +2244,7 @@ short ExtractorPrivate::writeData(struct archive_entry* entry) {
     }
 
     if (ret != ARCHIVE_OK) {
-      short err = ArchiveCorrupted;
-      if (PASSWORD_NEEDED(m_ArchiveRead.data())) {
-        err = ArchivePasswordNeeded;
-      } else if (PASSWORD_INCORRECT(m_ArchiveRead.data())) {
-        err = ArchivePasswordIncorrect;
-      }
+      const short err = readError(m_ArchiveRead.data());
       return err;
     }
 
@@ -956,20 +2254,18 @@ short ExtractorPrivate::writeData(struct archive_entry* entry) {
         return ArchiveWriteError;
       }
     } else {
-      (currentNode.getBuffer())->seek(offset);
-      if ((currentNode.getBuffer())
-              ->write(static_cast<const char*>(buff), size) == -1) {
+      if (!writeEntryBlock(currentNode.getBuffer().get(),
+                           static_cast<const char*>(buff),
+                           static_cast<qint64>(size), offset)) {
         return ArchiveWriteError;
       }
     }
     n_BytesProcessed += size;
-    if (n_BytesTotal > 0 && n_TotalEntries > 0) {
-      emit progress(archive_entry_pathname(entry), n_ProcessedEntries,
-                    n_TotalEntries, n_BytesProcessed, n_BytesTotal);
-    }
+    reportProgress(archive_entry_pathname(entry), /*entryDone=*/false);
 
-    // Allow the execution of the event loop
-    QCoreApplication::processEvents();
+    // Allow the execution of the event loop once in a while, pause and
+    // cancel requests are seen on every block regardless.
+    m_EventPump.pump();
 
     // Check for pause and cancel requests.
     if (b_PauseRequested) {
@@ -1002,6 +2298,141 @@ short ExtractorPrivate::writeData(struct archive_entry* entry) {
   return NoError;
 }
 
+// Writes the data of the current entry to the device the entry device
+// factory gives for it, one block at a time, instead of keeping it in
+// memory. An empty information means the entry was paused and the device
+// is already set.
+short ExtractorPrivate::writeDataToDevice(struct archive_entry* entry,
+                                          const QJsonObject& information) {
+  if (!information.isEmpty()) {
+    m_CurrentEntryDevice = m_EntryDeviceFactory(information);
+    n_EntryDeviceOffset = 0;
+
+    /// The caller does not want this entry.
+    if (!m_CurrentEntryDevice) {
+      n_BytesProcessed += archive_entry_size(entry);
+      return NoError;
+    }
+
+    if (!m_CurrentEntryDevice->isOpen() &&
+        !m_CurrentEntryDevice->open(QIODevice::WriteOnly)) {
+      m_CurrentEntryDevice = nullptr;
+      return ArchiveHeaderWriteError;
+    }
+  }
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+  qsizetype ret = ARCHIVE_OK;
+#else
+  qptrdiff ret = ARCHIVE_OK;
+#endif
+  // Closes the device of an entry that can't be completed.
+  auto closeDevice = [this](short err) {
+    m_CurrentEntryDevice->close();
+    m_CurrentEntryDevice = nullptr;
+    return err;
+  };
+  const void* buff;
+  size_t size;
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+  int64_t offset;
+#else
+  off_t offset;
+#endif
+  for (;;) {
+    ret = archive_read_data_block(m_ArchiveRead.data(), &buff, &size, &offset);
+    if (ret == ARCHIVE_EOF) {
+      break;
+    }
+
+    if (ret != ARCHIVE_OK) {
+      const short err = readError(m_ArchiveRead.data());
+      return closeDevice(err);
+    }
+
+    if (!writeDeviceBlock(m_CurrentEntryDevice, static_cast<const char*>(buff),
+                          static_cast<qint64>(size), offset,
+                          &n_EntryDeviceOffset)) {
+      return closeDevice(ArchiveWriteError);
+    }
+    n_BytesProcessed += size;
+    reportProgress(archive_entry_pathname(entry), /*entryDone=*/false);
+
+    m_EventPump.pump();
+
+    if (b_PauseRequested) {
+      b_PauseRequested = false;
+      m_CurrentArchiveEntry = entry;
+      return OperationPaused;
+    }
+    if (b_CancelRequested) {
+      b_CancelRequested = false;
+      return closeDevice(OperationCanceled);
+    }
+  }
+
+  /// The entry is complete once its device is closed.
+  m_CurrentEntryDevice->close();
+  m_CurrentEntryDevice = nullptr;
+  return NoError;
+}
+
+// Returns the error for a failed read of the archive. A read which was
+// stopped by a cancel request while waiting for more data is a cancel, one
+// which waited longer than the sequential timeout is a timeout.
+// One stopped by a pause while following the archive leaves libarchive
+// halfway through an entry or a header where it can't go on, so resume()
+// reads the archive again and skips the entries which are done.
+short ExtractorPrivate::readError(struct archive* archive) {
+  if (b_CancelRequested) {
+    b_CancelRequested = false;
+    return OperationCanceled;
+  }
+  if (b_PauseRequested && n_FollowTimeout > 0 && !b_FollowedToEnd) {
+    b_PauseRequested = false;
+    m_EntriesDone.assign(n_ProcessedEntries, 1);
+    m_CurrentArchiveEntry = nullptr;
+    m_CurrentMemoryFile = MutableMemoryFile();
+    m_ArchiveRead.clear();
+    m_ArchiveWrite.clear();
+    return OperationPaused;
+  }
+  if (m_ReadStatistics.timedOut) {
+    return ArchiveReadTimeout;
+  }
+  if (PASSWORD_NEEDED(archive)) {
+    return ArchivePasswordNeeded;
+  }
+  if (PASSWORD_INCORRECT(archive)) {
+    return ArchivePasswordIncorrect;
+  }
+  return ArchiveCorrupted;
+}
+
+// Emits how the archive was read by the last extraction.
+void ExtractorPrivate::emitStatistics() {
+  QJsonObject statistics;
+  statistics.insert("BlockSize", QJsonValue(m_ReadStatistics.blockSize));
+  statistics.insert("Reads", QJsonValue(m_ReadStatistics.reads));
+  statistics.insert("BytesRead", QJsonValue(m_ReadStatistics.bytesRead));
+  statistics.insert("CacheHits", QJsonValue(m_ReadStatistics.cacheHits));
+  statistics.insert("CacheMisses", QJsonValue(m_ReadStatistics.cacheMisses));
+  statistics.insert("Skips", QJsonValue(m_ReadStatistics.skips));
+  statistics.insert("BytesSkipped",
+                    QJsonValue(m_ReadStatistics.bytesSkipped));
+  statistics.insert("MemoryBacked",
+                    QJsonValue(m_ReadStatistics.memoryBacked));
+  statistics.insert("DecompressionThreads",
+                    QJsonValue(n_DecompressionThreads));
+  emit this->statistics(statistics);
+}
+
+// Returns true if the given entry passes the extract filters and the
+// include and exclude patterns.
+bool ExtractorPrivate::isEntryExtracted(struct archive_entry* entry) {
+  return m_ExtractFilter->isEntryExtracted(entry);
+}
+
 short ExtractorPrivate::getTotalEntriesCount() {
   if (!m_Archive) {
     return ArchiveNotGiven;
@@ -1023,8 +2454,8 @@ short ExtractorPrivate::getTotalEntriesCount() {
 #endif
 
   toggleArchiveFormat(inArchive);
-  archive_read_support_filter_all(inArchive);
-  if (archiveReadOpenQIODevice(inArchive, n_BlockSize, m_Archive)) {
+  if (archiveReadOpenQIODevice(inArchive, n_BlockSize, m_Archive,
+                               getReaderOptions())) {
     archive_read_close(inArchive);
     archive_read_free(inArchive);
     return ArchiveReadError;
@@ -1047,7 +2478,7 @@ short ExtractorPrivate::getTotalEntriesCount() {
     }
     count += 1;
     n_BytesTotal += archive_entry_size(entry);
-    QCoreApplication::processEvents();
+    m_EventPump.pump();
   }
 
   // set total number of entries.
@@ -1076,29 +2507,49 @@ short ExtractorPrivate::processArchiveInformation() {
   }
 #endif
   toggleArchiveFormat(inArchive);
-  archive_read_support_filter_all(inArchive);
 
-  if (archiveReadOpenQIODevice(inArchive, n_BlockSize, m_Archive)) {
+  // The header positions libarchive gives are relative to where the
+  // reader started.
+  const qint64 origin = m_Archive->isSequential() ? -1 : m_Archive->pos();
+  auto readerOptions = getReaderOptions();
+  readerOptions.statistics = &m_ReadStatistics;
+  if (archiveReadOpenQIODevice(inArchive, n_BlockSize, m_Archive,
+                               readerOptions)) {
     archive_read_close(inArchive);
     archive_read_free(inArchive);
-    return ArchiveReadError;
+    return m_ReadStatistics.timedOut ? ArchiveReadTimeout : ArchiveReadError;
   }
+  m_Index.clear();
   for (;;) {
     ret = archive_read_next_header(inArchive, &entry);
     if (ret == ARCHIVE_EOF) {
+      b_FollowedToEnd = n_FollowTimeout > 0;
       break;
     }
     if (ret != ARCHIVE_OK) {
       short err = ArchiveCorrupted;
-      if (PASSWORD_NEEDED(inArchive)) {
+      if (m_ReadStatistics.timedOut) {
+        err = ArchiveReadTimeout;
+      } else if (PASSWORD_NEEDED(inArchive)) {
         err = ArchivePasswordNeeded;
       } else if (PASSWORD_INCORRECT(inArchive)) {
         err = ArchivePasswordIncorrect;
       }
+      m_Index.clear();
       archive_read_close(inArchive);
       archive_read_free(inArchive);
       return err;
     }
+    IndexEntry indexEntry;
+    indexEntry.pathname = archive_entry_pathname(entry);
+    indexEntry.fileType = archive_entry_filetype(entry);
+    indexEntry.size = archive_entry_size(entry);
+    indexEntry.atime = archive_entry_atime(entry);
+    indexEntry.mtime = archive_entry_mtime(entry);
+    indexEntry.ctime = archive_entry_ctime(entry);
+    indexEntry.headerPosition = archive_read_header_position(inArchive);
+    m_Index.push_back(std::move(indexEntry));
+
     QString CurrentFile(archive_entry_pathname(entry));
     QJsonObject CurrentEntry = getArchiveEntryInformation(
         entry, m_archiveFilter->isEntryExcluded(entry));
@@ -1106,14 +2557,168 @@ short ExtractorPrivate::processArchiveInformation() {
     n_BytesTotal += archive_entry_size(entry);
     // Clear the entry since it is re-used by the libarchive internally that may lead to the stale data be taken.
     archive_entry_clear(entry);
-    QCoreApplication::processEvents();
+    m_EventPump.pump();
+  }
+
+  // libarchive takes the position before the format reads the header. Only
+  // for a tar archive without a filter is that where the header is in the
+  // device: the seekable ZIP and 7-Zip readers seek to the header
+  // themselves after that, and a filter gives positions in its output.
+  const bool seekable =
+      origin >= 0 &&
+      (archive_format(inArchive) & ARCHIVE_FORMAT_BASE_MASK) ==
+          ARCHIVE_FORMAT_TAR &&
+      archive_filter_code(inArchive, 0) == ARCHIVE_FILTER_NONE;
+  for (auto& indexEntry : m_Index) {
+    indexEntry.headerPosition =
+        seekable ? origin + indexEntry.headerPosition : -1;
   }
 
   // set total number of entries.
-  n_TotalEntries = m_Info.size();
+  n_TotalEntries = static_cast<int>(m_Index.size());
 
   // free memory.
   archive_read_close(inArchive);
   archive_read_free(inArchive);
   return NoError;
 }
+
+// Loads the entry index of the archive from the index cache directory,
+// returns true only if an index of the unchanged archive was found. The
+// information of getInfo() is not built here, extractEntries() and the
+// progress only need the index itself.
+bool ExtractorPrivate::loadIndexCache() {
+  if (m_IndexCacheDirectory.isEmpty() || m_ArchivePath.isEmpty()) {
+    return false;
+  }
+
+  IndexCacheKey key;
+  if (!getIndexCacheKey(m_ArchivePath, &key)) {
+    return false;
+  }
+
+  QFile file(getIndexCacheFileName(m_IndexCacheDirectory, key));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic = 0;
+  quint16 version = 0;
+  stream >> magic >> version;
+  if (magic != IndexCacheMagic || version != IndexCacheVersion) {
+    return false;
+  }
+
+  IndexCacheKey cached;
+  bool rawMode = false;
+  qint32 count = -1;
+  stream >> cached.path >> cached.size >> cached.modified >> cached.inode >>
+      rawMode >> count;
+  if (stream.status() != QDataStream::Ok || cached.path != key.path ||
+      cached.size != key.size || cached.modified != key.modified ||
+      cached.inode != key.inode || rawMode != b_RawMode || count < 0) {
+    return false;
+  }
+
+  std::vector<IndexEntry> index;
+  index.reserve(static_cast<size_t>(qMin(count, 1 << 20)));
+  qint64 bytesTotal = 0;
+  for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+    IndexEntry indexEntry;
+    stream >> indexEntry.pathname >> indexEntry.fileType >> indexEntry.size >>
+        indexEntry.atime >> indexEntry.mtime >> indexEntry.ctime >>
+        indexEntry.headerPosition;
+    bytesTotal += indexEntry.size;
+    index.push_back(std::move(indexEntry));
+  }
+  if (stream.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  m_Index = std::move(index);
+  m_Info = {};
+  n_TotalEntries = count;
+  n_BytesTotal = bytesTotal;
+  return true;
+}
+
+// Writes the entry index of the archive to the index cache directory, a
+// fixed header identifying the archive followed by a record for every
+// entry in the order they are stored.
+void ExtractorPrivate::saveIndexCache() {
+  if (m_IndexCacheDirectory.isEmpty() || m_ArchivePath.isEmpty() ||
+      m_Index.empty()) {
+    return;
+  }
+
+  IndexCacheKey key;
+  if (!getIndexCacheKey(m_ArchivePath, &key) ||
+      !QDir().mkpath(m_IndexCacheDirectory)) {
+    return;
+  }
+
+  QSaveFile file(getIndexCacheFileName(m_IndexCacheDirectory, key));
+  if (!file.open(QIODevice::WriteOnly)) {
+    return;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+  stream << IndexCacheMagic << IndexCacheVersion << key.path << key.size
+         << key.modified << key.inode << b_RawMode
+         << static_cast<qint32>(m_Index.size());
+  for (const auto& indexEntry : m_Index) {
+    stream << indexEntry.pathname << indexEntry.fileType << indexEntry.size
+           << indexEntry.atime << indexEntry.mtime << indexEntry.ctime
+           << indexEntry.headerPosition;
+  }
+
+  if (stream.status() == QDataStream::Ok) {
+    file.commit();
+  } else {
+    file.cancelWriting();
+  }
+}
+
+// Builds the information given by getInfo() from the index. The exclude
+// patterns may differ from the ones used when the index was listed, so
+// they are evaluated again.
+void ExtractorPrivate::buildInfoFromIndex() {
+  m_Info = {};
+  QSharedPointer<struct archive_entry> entry(archive_entry_new(),
+                                             ArchiveEntryDestructor);
+  for (const auto& indexEntry : m_Index) {
+    archive_entry_clear(entry.data());
+    archive_entry_copy_pathname(entry.data(), indexEntry.pathname.constData());
+    archive_entry_set_filetype(entry.data(), indexEntry.fileType);
+    archive_entry_set_size(entry.data(), indexEntry.size);
+    archive_entry_set_atime(entry.data(), indexEntry.atime, 0);
+    archive_entry_set_mtime(entry.data(), indexEntry.mtime, 0);
+    archive_entry_set_ctime(entry.data(), indexEntry.ctime, 0);
+    m_Info.insert(QString::fromUtf8(indexEntry.pathname),
+                  getArchiveEntryInformation(
+                      entry.data(),
+                      m_archiveFilter->isEntryExcluded(entry.data())));
+  }
+}
+
+// Returns where the header of the first entry asked for by extractEntries()
+// is in the archive, or -1 when reading starts at the beginning. Only the
+// index of a tar archive without a filter has these positions, entries of
+// other formats can't be read from their header on.
+qint64 ExtractorPrivate::indexedStartPosition() const {
+  if (!b_ExtractEntriesOnly || b_RawMode || n_FollowTimeout > 0 ||
+      !m_EntriesDone.empty() || m_Archive->isSequential()) {
+    return -1;
+  }
+  // The index is in the order of the archive.
+  for (const auto& indexEntry : m_Index) {
+    if (m_PendingEntries.contains(indexEntry.pathname)) {
+      return indexEntry.headerPosition;
+    }
+  }
+  return -1;
+}
@@ -1,8 +1,162 @@
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QThread>
 #include <qarchiveioreader_p.hpp>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 using namespace QArchive;
 
+namespace {
+// Block sizes picked when none is given. Files and memory are read in large
+// blocks to keep the calls per archive low, other devices in smaller ones
+// since they tend to have less data ready at a time.
+constexpr int FileBlockSize = 1024 * 1024;
+constexpr int MemoryBlockSize = 1024 * 1024;
+constexpr int DeviceBlockSize = 64 * 1024;
+
+// Read pages are only dropped from the page cache every this many bytes.
+constexpr qint64 DropPageCacheStep = 8 * 1024 * 1024;
+
+// The kernel is told this much of a file ahead is read next at a time.
+constexpr qint64 AdviseWindow = 8 * 1024 * 1024;
+
+// A read of a sequential device waits for more data this long at a time,
+// between the waits a cancel request is seen.
+constexpr int SequentialWaitSlice = 100;
+
+// How often a followed file is checked for more data.
+constexpr int FollowPollInterval = 50;
+
+// Up to this many missing blocks in a row are read from the device at once
+// on a miss of the block cache.
+constexpr int CacheCoalesceBlocks = 4;
+}  // namespace
+
+namespace QArchive {
+/* Reads the blocks following the current one from the device in a thread
+ * of its own, so that waiting on the storage overlaps with libarchive
+ * decoding the current block.
+ * The blocks live in a ring, the one handed out last is kept until the next
+ * read since libarchive uses it until then. The device must not be touched
+ * while the thread runs, stop() waits for it and drops the blocks read
+ * ahead, which is needed before every seek. */
+class ReadAhead {
+ public:
+  ReadAhead(QIODevice* device, int blockSize, int blocks)
+      : m_Device(device),
+        n_BlockSize(blockSize),
+        m_Blocks(blocks + 1),
+        m_Sizes(blocks + 1, 0) {
+    for (auto& block : m_Blocks) {
+      block.resize(blockSize);
+    }
+  }
+  ~ReadAhead() { stop(); }
+
+  Q_DISABLE_COPY(ReadAhead)
+
+  qint64 read(const void** block) {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if (!m_Thread.joinable()) {
+      b_Stop = b_Done = false;
+      m_Thread = std::thread(&ReadAhead::run, this);
+    }
+    b_Held = false;
+    m_Condition.notify_all();
+    m_Condition.wait(lock, [this]() { return n_Ready > 0 || b_Done; });
+    if (n_Ready == 0) {
+      return 0;
+    }
+    const size_t index = n_Next;
+    n_Next = (n_Next + 1) % m_Blocks.size();
+    --n_Ready;
+    b_Held = true;
+    *block = m_Blocks[index].constData();
+    return m_Sizes[index];
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      b_Stop = true;
+    }
+    m_Condition.notify_all();
+    if (m_Thread.joinable()) {
+      m_Thread.join();
+    }
+    n_Next = n_Ready = 0;
+    b_Held = b_Done = false;
+  }
+
+ private:
+  void run() {
+    for (;;) {
+      size_t index;
+      {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Condition.wait(lock, [this]() {
+          return b_Stop || n_Ready + (b_Held ? 1 : 0) < m_Blocks.size();
+        });
+        if (b_Stop) {
+          return;
+        }
+        index = (n_Next + n_Ready) % m_Blocks.size();
+      }
+
+      // The block is not handed out until it is counted as ready, so it is
+      // safe to fill it without the lock.
+      const qint64 n = m_Device->read(m_Blocks[index].data(), n_BlockSize);
+      {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Sizes[index] = n;
+        ++n_Ready;
+        b_Done = n <= 0;
+      }
+      m_Condition.notify_all();
+      if (n <= 0) {
+        return;
+      }
+    }
+  }
+
+  QIODevice* m_Device = nullptr;
+  int n_BlockSize = 0;
+  std::vector<QByteArray> m_Blocks;
+  std::vector<qint64> m_Sizes;
+  size_t n_Next = 0;
+  size_t n_Ready = 0;
+  bool b_Held = false;
+  bool b_Done = false;
+  bool b_Stop = false;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::thread m_Thread;
+};
+}  // namespace QArchive
+
+IOReaderPrivate::IOReaderPrivate() = default;
+
 IOReaderPrivate::~IOReaderPrivate() {
+  // Stop reading ahead before the device is touched.
+  m_ReadAhead.reset();
+#if defined(POSIX_FADV_DONTNEED)
+  if (b_DropPageCache && n_FileHandle >= 0) {
+    posix_fadvise(n_FileHandle, n_DroppedUntil, 0, POSIX_FADV_DONTNEED);
+  }
+#endif
+  if (m_Mapping) {
+    m_MappedFile->unmap(m_Mapping);
+  }
   if (isOpen() && isReadable() && !isSequential()) {
     // IMPORTANT: We need to make sure the IO Device
     // is at default when we close it finally.
@@ -12,12 +166,172 @@ IOReaderPrivate::~IOReaderPrivate() {
   }
 }
 
+// Sets the size of the blocks read at a time, 0 picks it from the device
+// and anything else below 1024 falls back to 10240.
 void IOReaderPrivate::setBlockSize(int blockSize) {
-  n_BlockSize = (blockSize < 1024) ? 10204 : blockSize;
+  n_RequestedBlockSize = (blockSize == 0 || blockSize >= 1024) ? blockSize
+                                                               : 10240;
+  updateBlockSize();
+}
+
+// Drops the pages of a file from the page cache once they were read, so
+// that extracting a large archive does not push everything else out of
+// it. Files are then read instead of mapped. Must be set before the
+// device.
+void IOReaderPrivate::setDropPageCache(bool enabled) {
+  b_DropPageCache = enabled;
+}
+
+void IOReaderPrivate::setStatistics(IOReaderStatistics* statistics) {
+  m_Statistics = statistics;
+  if (m_Statistics) {
+    *m_Statistics = IOReaderStatistics();
+    m_Statistics->blockSize = n_BlockSize;
+    m_Statistics->memoryBacked = isMemoryBacked();
+  }
+}
+
+int IOReaderPrivate::blockSize() const {
+  return n_BlockSize;
+}
+
+void IOReaderPrivate::updateBlockSize() {
+  if (n_RequestedBlockSize > 0) {
+    n_BlockSize = n_RequestedBlockSize;
+  } else if (m_Memory) {
+    n_BlockSize = MemoryBlockSize;
+  } else if (qobject_cast<QFile*>(m_IODevice)) {
+    n_BlockSize = FileBlockSize;
+  } else {
+    n_BlockSize = DeviceBlockSize;
+  }
+  if (m_Statistics) {
+    m_Statistics->blockSize = n_BlockSize;
+    m_Statistics->memoryBacked = isMemoryBacked();
+  }
+}
+
+// Tells the kernel that the file is read on from the given offset, a
+// window at a time so that it costs a call per window instead of one per
+// block, and drops what was read before it if asked to.
+void IOReaderPrivate::adviseRead(qint64 offset) {
+  if (n_FileHandle < 0 || offset + n_BlockSize <= n_AdvisedUntil) {
+    return;
+  }
+  const qint64 start = qMax(offset, n_AdvisedUntil);
+  n_AdvisedUntil = offset + qMax<qint64>(AdviseWindow, n_BlockSize);
+#if defined(MADV_WILLNEED)
+  if (m_Mapping) {
+    // The range has to start on a page.
+    const qint64 page = sysconf(_SC_PAGESIZE);
+    const qint64 aligned = start / page * page;
+    const qint64 end = qMin(n_AdvisedUntil, n_MemorySize);
+    if (end > aligned) {
+      madvise(m_Mapping + aligned, static_cast<size_t>(end - aligned),
+              MADV_WILLNEED);
+    }
+    return;
+  }
+#endif
+#if defined(POSIX_FADV_WILLNEED)
+  posix_fadvise(n_FileHandle, start, n_AdvisedUntil - start,
+                POSIX_FADV_WILLNEED);
+  if (b_DropPageCache && offset - n_DroppedUntil >= DropPageCacheStep) {
+    posix_fadvise(n_FileHandle, n_DroppedUntil, offset - n_DroppedUntil,
+                  POSIX_FADV_DONTNEED);
+    n_DroppedUntil = offset;
+  }
+#else
+  Q_UNUSED(start);
+#endif
+}
+
+// Reads the given number of blocks ahead in a thread of its own, 0 turns
+// it off. Files are read instead of mapped then. Must be set before the
+// device.
+void IOReaderPrivate::setReadAhead(int blocks) {
+  n_ReadAheadBlocks = qMax(blocks, 0);
+}
+
+// Waits up to the given milliseconds for a file to grow when its end is
+// reached, for archives which are still being written. 0 turns it off.
+// Files are read instead of mapped then and never read ahead. Must be set
+// before the device.
+void IOReaderPrivate::setFollowTimeout(int ms) {
+  n_FollowTimeout = qMax(ms, 0);
+}
+
+// Waits up to the given milliseconds for more data from a sequential device
+// before the archive is taken to end there, -1 waits until the device ends.
+void IOReaderPrivate::setSequentialTimeout(int ms) {
+  n_SequentialTimeout = qMax(ms, -1);
+}
+
+// Stops waiting for more data once the given flag is set, the read then
+// fails. The flag must outlive the reader.
+void IOReaderPrivate::setCancelFlag(const std::atomic<bool>* flag) {
+  m_CancelRequested = flag;
+}
+
+// Stops waiting for a followed file to grow once the given flag is set, the
+// read then fails. A sequential device can't be read again, so the wait for
+// it goes on. The flag must outlive the reader.
+void IOReaderPrivate::setPauseFlag(const std::atomic<bool>* flag) {
+  m_PauseRequested = flag;
+}
+
+// Keeps up to the given number of blocks read from the device, aligned to
+// the block size, and serves reads and seeks within them without touching
+// the device. Meant for devices where every seek is a round trip, such as
+// network file systems, 0 turns it off. Files are read instead of mapped
+// then and never read ahead. Must be set before the device.
+void IOReaderPrivate::setBlockCache(int blocks) {
+  n_CacheBlocks = qMax(blocks, 0);
 }
 
 void IOReaderPrivate::setIODevice(QIODevice* io) {
   m_IODevice = io;
+  if (!io || !io->isOpen() || !io->isReadable() || io->isSequential()) {
+    return;
+  }
+
+  // Archives which are already in memory are read in place, regular files
+  // and uncompressed resources are mapped. Anything else is read through
+  // the device.
+  if (auto buffer = qobject_cast<QBuffer*>(io)) {
+    m_Memory = buffer->data().constData();
+    n_MemorySize = buffer->data().size();
+  } else if (auto file = qobject_cast<QFile*>(io)) {
+    const qint64 size = file->size();
+    if (size > 0 && !b_DropPageCache && n_ReadAheadBlocks == 0 &&
+        n_FollowTimeout == 0 && n_CacheBlocks == 0) {
+      m_Mapping = file->map(0, size);
+    }
+    if (m_Mapping) {
+      m_MappedFile = file;
+      m_Memory = reinterpret_cast<const char*>(m_Mapping);
+      n_MemorySize = size;
+    }
+    n_FileHandle = file->handle();
+#if defined(MADV_SEQUENTIAL)
+    if (m_Mapping) {
+      madvise(m_Mapping, static_cast<size_t>(size), MADV_SEQUENTIAL);
+    }
+#endif
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (n_FileHandle >= 0 && !m_Mapping) {
+      posix_fadvise(n_FileHandle, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+  }
+  if (!m_Memory && n_CacheBlocks > 0 && n_FollowTimeout == 0) {
+    m_BlockCache.reset(new QCache<qint64, QByteArray>(n_CacheBlocks));
+    n_MemorySize = io->size();
+  }
+  if (m_Memory || m_BlockCache) {
+    n_MemoryPos = io->pos();
+  }
+  updateBlockSize();
 }
 
 bool IOReaderPrivate::isOpen() const {
@@ -34,6 +348,10 @@ bool IOReaderPrivate::isReadable() const {
   return false;
 }
 
+bool IOReaderPrivate::isMemoryBacked() const {
+  return m_Memory != nullptr;
+}
+
 bool IOReaderPrivate::isSequential() const {
   if (m_IODevice) {
     return m_IODevice->isSequential();
@@ -42,15 +360,158 @@ bool IOReaderPrivate::isSequential() const {
 }
 
 qint64 IOReaderPrivate::read(char* buffer) {
-  return m_IODevice ? m_IODevice->read(buffer, n_BlockSize) : -1;
+  if (!m_IODevice) {
+    return -1;
+  }
+  const qint64 pos = m_IODevice->pos();
+  qint64 n = m_IODevice->read(buffer, n_BlockSize);
+  if (n > 0) {
+    adviseRead(pos + n);
+  }
+
+  // Sequential devices like sockets and pipes have no data for a while
+  // before they have more, wait for it. A wait that fails before its slice
+  // is over means the device is done, it has ended or was closed. One that
+  // runs out of time is an error, not the end of the archive, else an
+  // archive cut short at an entry would look complete.
+  if (n == 0 && m_IODevice->isSequential()) {
+    QElapsedTimer waited;
+    waited.start();
+    while (n == 0) {
+      if (m_CancelRequested && *m_CancelRequested) {
+        return -1;
+      }
+      const qint64 left = n_SequentialTimeout < 0
+                              ? SequentialWaitSlice
+                              : n_SequentialTimeout - waited.elapsed();
+      if (left <= 0) {
+        if (m_Statistics) {
+          m_Statistics->timedOut = true;
+        }
+        return -1;
+      }
+      const int slice =
+          static_cast<int>(qMin<qint64>(left, SequentialWaitSlice));
+      QElapsedTimer wait;
+      wait.start();
+      const bool ready = m_IODevice->waitForReadyRead(slice);
+      n = m_IODevice->read(buffer, n_BlockSize);
+      if (!ready && wait.elapsed() < slice) {
+        break;
+      }
+    }
+  }
+
+  // A followed file may not be complete yet, poll it for more data until
+  // it stays the same for the timeout or a pause or cancel is requested.
+  if (n == 0 && n_FollowTimeout > 0 && !m_IODevice->isSequential()) {
+    QElapsedTimer idle;
+    idle.start();
+    while (n == 0 && idle.elapsed() < n_FollowTimeout) {
+      if ((m_CancelRequested && *m_CancelRequested) ||
+          (m_PauseRequested && *m_PauseRequested)) {
+        return -1;
+      }
+      QThread::msleep(FollowPollInterval);
+      n = m_IODevice->read(buffer, n_BlockSize);
+    }
+  }
+  if (m_Statistics) {
+    ++m_Statistics->reads;
+    m_Statistics->bytesRead += qMax<qint64>(n, 0);
+  }
+  return n;
+}
+
+// Points the given pointer at the next block, a slice of the memory
+// backing the device if there is one, otherwise the given buffer after
+// reading into it.
+qint64 IOReaderPrivate::read(const void** block, char* buffer) {
+  if (m_BlockCache) {
+    if (n_MemoryPos >= n_MemorySize) {
+      return 0;
+    }
+    const qint64 index = n_MemoryPos / n_BlockSize;
+    const QByteArray* data = loadCachedBlock(index);
+    if (!data) {
+      return -1;
+    }
+    const qint64 offset = n_MemoryPos - index * n_BlockSize;
+    const qint64 n = data->size() - offset;
+    if (n <= 0) {
+      return 0;
+    }
+    *block = data->constData() + offset;
+    n_MemoryPos += n;
+    return n;
+  }
+
+  // Sequential devices are never read ahead, they are waited on and that
+  // can only be done from their own thread.
+  if (!m_Memory && n_ReadAheadBlocks > 0 && n_FollowTimeout == 0 &&
+      m_IODevice && !m_IODevice->isSequential()) {
+    if (!m_ReadAhead) {
+      n_ReadAheadPos = m_IODevice->pos();
+      m_ReadAhead.reset(
+          new ReadAhead(m_IODevice, n_BlockSize, n_ReadAheadBlocks));
+    }
+    const qint64 n = m_ReadAhead->read(block);
+    if (n > 0) {
+      n_ReadAheadPos += n;
+      adviseRead(n_ReadAheadPos);
+    }
+    if (m_Statistics) {
+      ++m_Statistics->reads;
+      m_Statistics->bytesRead += qMax<qint64>(n, 0);
+    }
+    return n;
+  }
+  if (!m_Memory) {
+    *block = buffer;
+    return read(buffer);
+  }
+  const qint64 n = qMin<qint64>(n_BlockSize, n_MemorySize - n_MemoryPos);
+  *block = m_Memory + n_MemoryPos;
+  n_MemoryPos += n;
+  adviseRead(n_MemoryPos);
+  if (m_Statistics) {
+    ++m_Statistics->reads;
+    m_Statistics->bytesRead += n;
+  }
+  return n;
 }
 
 qint64 IOReaderPrivate::seek(qint64 offset, int whence) {
   if (!m_IODevice) {
     return -1;
   }
+  // The next read gives the advice from wherever it lands.
+  n_AdvisedUntil = 0;
 
   auto value = offset;
+  if (m_Memory || m_BlockCache) {
+    switch (whence) {
+      case SEEK_CUR:
+        value += n_MemoryPos;
+        break;
+      case SEEK_END:
+        value += n_MemorySize;
+        break;
+      default:
+        break;
+    }
+    if (value < 0 || value > n_MemorySize) {
+      return -1;
+    }
+    n_MemoryPos = value;
+    return value;
+  }
+
+  // The blocks read ahead are of the old position, and the thread must be
+  // done with the device before it is asked anything.
+  if (m_ReadAhead) {
+    m_ReadAhead->stop();
+  }
 
   // Whence can be
   // SEEK_SET - Simply sets the seek
@@ -62,7 +523,8 @@ qint64 IOReaderPrivate::seek(qint64 offset, int whence) {
 
   switch (whence) {
     case SEEK_CUR:
-      value += m_IODevice->pos();
+      // The device is ahead of libarchive while reading ahead.
+      value += m_ReadAhead ? n_ReadAheadPos : m_IODevice->pos();
       break;
     case SEEK_END:
       value += m_IODevice->size();
@@ -71,5 +533,89 @@ qint64 IOReaderPrivate::seek(qint64 offset, int whence) {
       break;
   }
 
-  return m_IODevice->seek(value) ? value : -1;
+  if (!m_IODevice->seek(value)) {
+    return -1;
+  }
+  if (m_ReadAhead) {
+    n_ReadAheadPos = value;
+  }
+  return value;
+}
+
+// Skips over the given bytes without reading them and returns how many
+// were skipped, which is less at the end of the device. Returns 0 for
+// sequential devices so that libarchive reads over the data instead.
+qint64 IOReaderPrivate::skip(qint64 request) {
+  if (!m_IODevice || request <= 0) {
+    return 0;
+  }
+  qint64 n = 0;
+  if (m_Memory || m_BlockCache) {
+    n = qMin(request, n_MemorySize - n_MemoryPos);
+    n_MemoryPos += n;
+  } else if (m_IODevice->isSequential()) {
+    return 0;
+  } else {
+    // Skipping seeks anyway, so reading ahead is stopped and the device put
+    // back where libarchive is before its size is asked.
+    if (m_ReadAhead && seek(0, SEEK_CUR) < 0) {
+      return 0;
+    }
+    const qint64 pos = m_IODevice->pos();
+    n = qMin(request, m_IODevice->size() - pos);
+    if (n <= 0 || seek(pos + n, SEEK_SET) < 0) {
+      return 0;
+    }
+  }
+  if (m_Statistics && n > 0) {
+    ++m_Statistics->skips;
+    m_Statistics->bytesSkipped += n;
+  }
+  return n;
+}
+
+// Returns the block of the given index from the block cache, reading it
+// from the device on a miss along with the missing blocks after it, so
+// that reading on from a miss does not cost a round trip per block.
+QByteArray* IOReaderPrivate::loadCachedBlock(qint64 index) {
+  if (auto data = m_BlockCache->object(index)) {
+    if (m_Statistics) {
+      ++m_Statistics->cacheHits;
+    }
+    return data;
+  }
+  if (m_Statistics) {
+    ++m_Statistics->cacheMisses;
+  }
+
+  const qint64 blocks = (n_MemorySize + n_BlockSize - 1) / n_BlockSize;
+  const int maxCount = qMin(CacheCoalesceBlocks, n_CacheBlocks);
+  int count = 1;
+  while (count < maxCount && index + count < blocks &&
+         !m_BlockCache->contains(index + count)) {
+    ++count;
+  }
+
+  if (!m_IODevice->seek(index * n_BlockSize)) {
+    return nullptr;
+  }
+  const QByteArray span = m_IODevice->read(qint64(count) * n_BlockSize);
+  if (m_Statistics) {
+    ++m_Statistics->reads;
+    m_Statistics->bytesRead += span.size();
+  }
+  if (span.isEmpty()) {
+    return nullptr;
+  }
+
+  // The asked block goes in last so that it is the most recently used and
+  // not evicted by the ones after it.
+  const int spanBlocks =
+      static_cast<int>((span.size() + n_BlockSize - 1) / n_BlockSize);
+  for (int i = spanBlocks - 1; i > 0; --i) {
+    m_BlockCache->insert(index + i,
+                         new QByteArray(span.mid(i * n_BlockSize, n_BlockSize)));
+  }
+  m_BlockCache->insert(index, new QByteArray(span.left(n_BlockSize)));
+  return m_BlockCache->object(index);
 }
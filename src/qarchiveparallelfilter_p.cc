@@ -0,0 +1,664 @@
+#include <QSharedPointer>
+#include <qarchive_enums.hpp>
+#include <qarchiveparallelfilter_p.hpp>
+#include <qarchiveutils_p.hpp>
+
+#include <cstring>
+#include <limits>
+
+extern "C" {
+#include <archive.h>
+#include <archive_entry.h>
+}
+
+// Support older libarchive versions where la_ssize_t is not defined yet
+#if ARCHIVE_VERSION_NUMBER <= 3001002
+#define la_ssize_t __LA_SSIZE_T
+#endif
+
+using namespace QArchive;
+
+namespace {
+// gzip members are cut every MiB, the window of deflate is only 32 KiB so
+// starting over costs next to nothing. bzip2 streams are cut at its largest
+// block size, which is what a single stream would compress at a time.
+constexpr int GZipChunkSize = 1024 * 1024;
+constexpr int BZip2ChunkSize = 900 * 1000;
+
+// Members and frames are read until a chunk holds at least this many bytes
+// of compressed input.
+constexpr int DecompressChunkSize = 1024 * 1024;
+
+// A zstd stream whose first frame has more blocks than this is taken as a
+// single stream, walking it would read most of the archive up front.
+constexpr int ZstdMaxDetectBlocks = 1024;
+
+constexpr quint32 ZstdMagic = 0xFD2FB528;
+constexpr quint32 ZstdSkippableMagic = 0x184D2A50;  // The low 4 bits vary.
+constexpr quint32 ZstdSkippableMask = 0xFFFFFFF0;
+
+quint32 readLE(const char* data, int bytes) {
+  quint32 value = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    value = (value << 8) | static_cast<uchar>(data[i]);
+  }
+  return value;
+}
+
+// The size of the BGZF member the given gzip header starts, 0 if the header
+// is not the one of a BGZF member or is cut short.
+qint64 getBgzfMemberSize(const QByteArray& header) {
+  if (header.size() < 12 || static_cast<uchar>(header[0]) != 0x1F ||
+      static_cast<uchar>(header[1]) != 0x8B || header[2] != 8 ||
+      !(header[3] & 4)) {
+    return 0;
+  }
+  const int extraSize = static_cast<int>(readLE(header.constData() + 10, 2));
+  if (header.size() < 12 + extraSize) {
+    return 0;
+  }
+  // The BC subfield holds the size of the member minus one.
+  int pos = 12;
+  while (pos + 4 <= 12 + extraSize) {
+    const int fieldSize =
+        static_cast<int>(readLE(header.constData() + pos + 2, 2));
+    if (header[pos] == 'B' && header[pos + 1] == 'C' && fieldSize == 2 &&
+        pos + 6 <= 12 + extraSize) {
+      return readLE(header.constData() + pos + 4, 2) + 1;
+    }
+    pos += 4 + fieldSize;
+  }
+  return 0;
+}
+
+// The size of the zstd frame header after the magic, from its first byte.
+int getZstdFrameHeaderSize(uchar descriptor) {
+  static const int dictionaryIdSizes[] = {0, 1, 2, 4};
+  static const int contentSizeSizes[] = {0, 2, 4, 8};
+  const bool singleSegment = descriptor & 0x20;
+  int size = 1 + (singleSegment ? 0 : 1) + dictionaryIdSizes[descriptor & 3];
+  const int contentSizeFlag = descriptor >> 6;
+  size += (contentSizeFlag == 0 && singleSegment)
+              ? 1
+              : contentSizeSizes[contentSizeFlag];
+  return size;
+}
+
+la_ssize_t appendOutput(struct archive*, void* data, const void* buffer,
+                        size_t length) {
+  static_cast<QByteArray*>(data)->append(static_cast<const char*>(buffer),
+                                         static_cast<int>(length));
+  return static_cast<la_ssize_t>(length);
+}
+}  // namespace
+
+ParallelFilterWriter::ParallelFilterWriter(QIODevice* device,
+                                           short format,
+                                           int threads,
+                                           int level)
+    : m_Device(device),
+      n_Format(format),
+      n_Level(level),
+      n_ChunkSize(format == GZipFormat ? GZipChunkSize : BZip2ChunkSize),
+      n_MaxChunks(2 * static_cast<size_t>(qMax(threads, 1))) {
+  m_Current.reserve(n_ChunkSize);
+  for (int i = 0; i < qMax(threads, 1); ++i) {
+    m_Threads.emplace_back(&ParallelFilterWriter::run, this);
+  }
+}
+
+ParallelFilterWriter::~ParallelFilterWriter() {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    b_Stop = true;
+  }
+  m_Condition.notify_all();
+  for (auto& thread : m_Threads) {
+    thread.join();
+  }
+}
+
+QIODevice* ParallelFilterWriter::device() const {
+  return m_Device;
+}
+
+// Takes the next bytes of the stream, compressing every chunk once it is
+// full. Blocks when too many chunks are waiting to be written.
+bool ParallelFilterWriter::write(const char* data, qint64 size) {
+  if (b_Failed) {
+    return false;
+  }
+  while (size > 0) {
+    const qint64 n = qMin<qint64>(size, n_ChunkSize - m_Current.size());
+    m_Current.append(data, static_cast<int>(n));
+    data += n;
+    size -= n;
+    if (m_Current.size() == n_ChunkSize && !submit()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Compresses what is left of the stream and writes everything out.
+bool ParallelFilterWriter::finish() {
+  if (!m_Current.isEmpty() && !submit()) {
+    return false;
+  }
+  return writeFinished(/*keep=*/0);
+}
+
+void ParallelFilterWriter::run() {
+  for (;;) {
+    std::shared_ptr<Chunk> chunk;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_Condition.wait(lock, [&]() {
+        for (auto& pending : m_Chunks) {
+          if (!pending->started) {
+            chunk = pending;
+            return true;
+          }
+        }
+        return b_Stop;
+      });
+      if (!chunk) {
+        return;
+      }
+      chunk->started = true;
+    }
+
+    const bool compressed = compress(chunk.get());
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      chunk->failed = !compressed;
+      chunk->done = true;
+      chunk->input.clear();
+    }
+    m_Condition.notify_all();
+  }
+}
+
+// Hands the current chunk to the threads and writes the chunks before it
+// which are done, waiting for them if too many are pending.
+bool ParallelFilterWriter::submit() {
+  auto chunk = std::make_shared<Chunk>();
+  chunk->input.swap(m_Current);
+  m_Current.reserve(n_ChunkSize);
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Chunks.push_back(chunk);
+  }
+  m_Condition.notify_all();
+  return writeFinished(/*keep=*/n_MaxChunks - 1);
+}
+
+// Writes the chunks at the front which are done, waiting for them until at
+// most the given number of chunks are left.
+bool ParallelFilterWriter::writeFinished(size_t keep) {
+  while (!b_Failed) {
+    std::shared_ptr<Chunk> chunk;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      if (m_Chunks.empty()) {
+        break;
+      }
+      if (m_Chunks.size() > keep) {
+        m_Condition.wait(lock, [this]() { return m_Chunks.front()->done; });
+      } else if (!m_Chunks.front()->done) {
+        break;
+      }
+      chunk = m_Chunks.front();
+      m_Chunks.pop_front();
+    }
+    if (chunk->failed ||
+        m_Device->write(chunk->output) != chunk->output.size()) {
+      b_Failed = true;
+    }
+  }
+  return !b_Failed;
+}
+
+// Compresses a chunk on its own through libarchive, as the single entry of
+// a raw archive which is nothing but the filtered data.
+bool ParallelFilterWriter::compress(Chunk* chunk) const {
+  QSharedPointer<struct archive> archive(archive_write_new(),
+                                         ArchiveWriteDestructor);
+  if (!archive) {
+    return false;
+  }
+  if (n_Format == GZipFormat) {
+    archive_write_add_filter_gzip(archive.data());
+#if ARCHIVE_VERSION_NUMBER >= 3002000
+    // Keeps the output the same from one run to the next.
+    archive_write_set_filter_option(archive.data(), "gzip", "timestamp",
+                                    nullptr);
+#endif
+  } else {
+    archive_write_add_filter_bzip2(archive.data());
+  }
+  if (n_Level >= 0) {
+    archive_write_set_filter_option(archive.data(), nullptr,
+                                    "compression-level",
+                                    QByteArray::number(n_Level).constData());
+  }
+  archive_write_set_format_raw(archive.data());
+  // The chunks are concatenated, so nothing may pad them.
+  archive_write_set_bytes_per_block(archive.data(), 0);
+
+  chunk->output.reserve(chunk->input.size() / 2);
+  if (archive_write_open(archive.data(), &chunk->output, nullptr, appendOutput,
+                         nullptr) != ARCHIVE_OK) {
+    return false;
+  }
+
+  QSharedPointer<struct archive_entry> entry(archive_entry_new(),
+                                             ArchiveEntryDestructor);
+  archive_entry_set_filetype(entry.data(), AE_IFREG);
+  archive_entry_set_size(entry.data(), chunk->input.size());
+  if (archive_write_header(archive.data(), entry.data()) != ARCHIVE_OK) {
+    return false;
+  }
+  if (archive_write_data(archive.data(), chunk->input.constData(),
+                         chunk->input.size()) != chunk->input.size()) {
+    return false;
+  }
+  return archive_write_close(archive.data()) == ARCHIVE_OK;
+}
+
+ParallelFilterReader::ParallelFilterReader(QIODevice* source,
+                                           short format,
+                                           int threads)
+    : m_Source(source),
+      n_Format(format),
+      n_MaxChunks(2 * static_cast<size_t>(qMax(threads, 1))) {
+  open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+  for (int i = 0; i < qMax(threads, 1); ++i) {
+    m_Threads.emplace_back(&ParallelFilterReader::run, this);
+  }
+}
+
+ParallelFilterReader::~ParallelFilterReader() {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    b_Stop = true;
+    m_Chunks.clear();
+  }
+  m_Condition.notify_all();
+  for (auto& thread : m_Threads) {
+    thread.join();
+  }
+  // Like the reader of the archive, leave the source at its start.
+  if (m_Source && m_Source->isOpen() && !m_Source->isSequential()) {
+    m_Source->seek(0);
+  }
+}
+
+// GZipFormat if the device starts with a BGZF member, ZstdFormat if it
+// starts with a zstd frame which is not the last one. 0 for anything else
+// and sequential devices. The position of the device is kept.
+short ParallelFilterReader::detect(QIODevice* device) {
+  if (!device || !device->isOpen() || device->isSequential()) {
+    return 0;
+  }
+  const QByteArray head = device->peek(64 * 1024 + 12);
+  if (getBgzfMemberSize(head) > 0) {
+    return GZipFormat;
+  }
+#if ARCHIVE_VERSION_NUMBER < 3003003
+  // Without the zstd filter of libarchive the frames can't be decompressed
+  // here either.
+  return 0;
+#else
+  if (head.size() < 4) {
+    return 0;
+  }
+  const quint32 magic = readLE(head.constData(), 4);
+  if ((magic & ZstdSkippableMask) == ZstdSkippableMagic) {
+    // Only pzstd and the like write these in front of their frames.
+    return ZstdFormat;
+  }
+  if (magic != ZstdMagic || head.size() < 5) {
+    return 0;
+  }
+
+  // Walk the block headers of the first frame to find where it ends.
+  const qint64 start = device->pos();
+  const auto descriptor = static_cast<uchar>(head[4]);
+  qint64 pos = start + 4 + getZstdFrameHeaderSize(descriptor);
+  bool last = false;
+  for (int blocks = 0; !last && blocks < ZstdMaxDetectBlocks; ++blocks) {
+    char header[3];
+    if (!device->seek(pos) || device->read(header, 3) != 3) {
+      break;
+    }
+    const quint32 block = readLE(header, 3);
+    const int type = (block >> 1) & 3;
+    if (type == 3) {
+      break;
+    }
+    last = block & 1;
+    pos += 3 + (type == 1 ? 1 : (block >> 3));
+  }
+  device->seek(start);
+  if (!last) {
+    return 0;
+  }
+  if (descriptor & 4) {
+    pos += 4;  // The checksum of the content.
+  }
+  return pos < device->size() ? ZstdFormat : 0;
+#endif
+}
+
+bool ParallelFilterReader::isSequential() const {
+  return true;
+}
+
+// The bytes read from the source so far.
+qint64 ParallelFilterReader::inputPosition() const {
+  return n_InputPosition + m_TailStatistics.bytesRead;
+}
+
+qint64 ParallelFilterReader::readData(char* data, qint64 maxSize) {
+  qint64 total = 0;
+  while (total < maxSize) {
+    if (!m_Current || n_CurrentPos == m_Current->output.size()) {
+      // Hand out what there is before waiting for the next chunk.
+      if (total > 0) {
+        break;
+      }
+      m_Current = takeChunk();
+      n_CurrentPos = 0;
+      if (!m_Current) {
+        if (b_Tail && !b_Failed) {
+          const qint64 n = readTail(data, maxSize);
+          b_Failed = n < 0;
+          total = qMax<qint64>(n, 0);
+        }
+        break;
+      }
+      continue;
+    }
+    const qint64 n =
+        qMin<qint64>(maxSize - total, m_Current->output.size() - n_CurrentPos);
+    memcpy(data + total, m_Current->output.constData() + n_CurrentPos, n);
+    n_CurrentPos += static_cast<int>(n);
+    total += n;
+  }
+  if (total == 0 && b_Failed) {
+    return -1;
+  }
+  return total;
+}
+
+qint64 ParallelFilterReader::writeData(const char*, qint64) {
+  return -1;
+}
+
+void ParallelFilterReader::run() {
+  for (;;) {
+    std::shared_ptr<Chunk> chunk;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_Condition.wait(lock, [&]() {
+        if (b_Stop) {
+          return true;
+        }
+        for (auto& pending : m_Chunks) {
+          if (!pending->started) {
+            chunk = pending;
+            return true;
+          }
+        }
+        return false;
+      });
+      if (!chunk) {
+        return;
+      }
+      chunk->started = true;
+    }
+
+    const bool decompressed = decompress(chunk.get());
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      chunk->failed = !decompressed;
+      chunk->done = true;
+      chunk->input.clear();
+    }
+    m_Condition.notify_all();
+  }
+}
+
+// Reads chunks from the source for the threads until enough are pending.
+void ParallelFilterReader::schedule() {
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      if (b_InputDone || m_Chunks.size() >= n_MaxChunks) {
+        return;
+      }
+    }
+
+    auto chunk = std::make_shared<Chunk>();
+    int ret = 1;
+    while (ret > 0 && chunk->input.size() < DecompressChunkSize) {
+      ret = n_Format == GZipFormat ? readMember(&chunk->input)
+                                   : readFrame(&chunk->input);
+    }
+    n_InputPosition += chunk->input.size();
+    if (ret < 0) {
+      // Malformed input fails once the chunks before it are handed out.
+      chunk->input.clear();
+      chunk->done = chunk->started = chunk->failed = true;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      b_InputDone = ret <= 0;
+      if (chunk->failed || !chunk->input.isEmpty()) {
+        m_Chunks.push_back(chunk);
+      }
+    }
+    m_Condition.notify_all();
+  }
+}
+
+// The next chunk in order once it is decompressed, nullptr at the end or
+// when it failed.
+std::shared_ptr<ParallelFilterReader::Chunk> ParallelFilterReader::takeChunk() {
+  if (b_Failed) {
+    return nullptr;
+  }
+  schedule();
+
+  std::shared_ptr<Chunk> chunk;
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if (m_Chunks.empty()) {
+      return nullptr;
+    }
+    m_Condition.wait(lock, [this]() { return m_Chunks.front()->done; });
+    chunk = m_Chunks.front();
+    m_Chunks.pop_front();
+  }
+  // Keep the threads busy while this one is read.
+  schedule();
+
+  if (chunk->failed) {
+    b_Failed = true;
+    return nullptr;
+  }
+  return chunk;
+}
+
+// Appends the next BGZF member of the source, 0 at the end of the source
+// and -1 if it does not hold a gzip member. Another gzip member ends the
+// members as well, see leaveTail().
+int ParallelFilterReader::readMember(QByteArray* input) {
+  const int start = input->size();
+  if (!readSource(input, 12)) {
+    return input->size() == start ? 0 : -1;
+  }
+  const char* header = input->constData() + start;
+  if (static_cast<uchar>(header[0]) != 0x1F ||
+      static_cast<uchar>(header[1]) != 0x8B) {
+    return -1;
+  }
+  if (!(header[3] & 4)) {
+    return leaveTail(input, start);  // No extra field, so no BC subfield.
+  }
+  const int extraSize = static_cast<int>(readLE(header + 10, 2));
+  if (!readSource(input, extraSize)) {
+    return -1;
+  }
+  const qint64 size = getBgzfMemberSize(input->mid(start));
+  if (size == 0) {
+    return leaveTail(input, start);
+  }
+  if (size < 12 + extraSize || !readSource(input, size - 12 - extraSize)) {
+    return -1;
+  }
+  return 1;
+}
+
+// Puts the header of a gzip member which is not a BGZF member back into
+// the source, the rest of the source is decompressed by readTail() after
+// the chunks. Returns 0 like the end of the source.
+int ParallelFilterReader::leaveTail(QByteArray* input, int start) {
+  const qint64 read = input->size() - start;
+  input->resize(start);
+  if (!m_Source->seek(m_Source->pos() - read)) {
+    return -1;
+  }
+  b_Tail = true;
+  return 0;
+}
+
+// Appends the next zstd frame of the source, skippable frames included, 0
+// at the end of the source and -1 if it does not hold a zstd frame.
+int ParallelFilterReader::readFrame(QByteArray* input) {
+  const int start = input->size();
+  if (!readSource(input, 4)) {
+    return input->size() == start ? 0 : -1;
+  }
+  const quint32 magic = readLE(input->constData() + start, 4);
+  if ((magic & ZstdSkippableMask) == ZstdSkippableMagic) {
+    if (!readSource(input, 4)) {
+      return -1;
+    }
+    const qint64 size = readLE(input->constData() + start + 4, 4);
+    return readSource(input, size) ? 1 : -1;
+  }
+  if (magic != ZstdMagic || !readSource(input, 1)) {
+    return -1;
+  }
+
+  const auto descriptor = static_cast<uchar>(input->at(start + 4));
+  if (!readSource(input, getZstdFrameHeaderSize(descriptor) - 1)) {
+    return -1;
+  }
+  for (bool last = false; !last;) {
+    if (!readSource(input, 3)) {
+      return -1;
+    }
+    const quint32 block = readLE(input->constData() + input->size() - 3, 3);
+    const int type = (block >> 1) & 3;
+    if (type == 3 || !readSource(input, type == 1 ? 1 : (block >> 3))) {
+      return -1;
+    }
+    last = block & 1;
+  }
+  if ((descriptor & 4) && !readSource(input, 4)) {
+    return -1;
+  }
+  return 1;
+}
+
+// Appends exactly the given number of bytes of the source.
+bool ParallelFilterReader::readSource(QByteArray* input, qint64 size) {
+  const int start = input->size();
+  if (size > std::numeric_limits<int>::max() - start) {
+    return false;
+  }
+  input->resize(start + static_cast<int>(size));
+  qint64 done = 0;
+  while (done < size) {
+    const qint64 n = m_Source->read(input->data() + start + done, size - done);
+    if (n <= 0) {
+      input->resize(start + static_cast<int>(done));
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+// Decompresses the rest of the source as a single gzip stream on the
+// thread which reads, through libarchive as a raw archive.
+qint64 ParallelFilterReader::readTail(char* data, qint64 maxSize) {
+  if (!m_Tail) {
+    m_Tail = QSharedPointer<struct archive>(archive_read_new(),
+                                            ArchiveReadDestructor);
+    if (!m_Tail) {
+      return -1;
+    }
+    archive_read_support_filter_gzip(m_Tail.data());
+    archive_read_support_format_raw(m_Tail.data());
+    IOReaderOptions options;
+    options.statistics = &m_TailStatistics;
+    struct archive_entry* entry = nullptr;
+    if (archiveReadOpenQIODevice(m_Tail.data(), 0, m_Source, options) !=
+            ARCHIVE_OK ||
+        archive_read_next_header(m_Tail.data(), &entry) != ARCHIVE_OK) {
+      return -1;
+    }
+  }
+  const la_ssize_t n = archive_read_data(m_Tail.data(), data,
+                                         static_cast<size_t>(maxSize));
+  return n < 0 ? -1 : static_cast<qint64>(n);
+}
+
+// Decompresses a chunk on its own through libarchive, as a raw archive
+// whose only entry is the decompressed data.
+bool ParallelFilterReader::decompress(Chunk* chunk) const {
+  QSharedPointer<struct archive> archive(archive_read_new(),
+                                         ArchiveReadDestructor);
+  if (!archive) {
+    return false;
+  }
+  if (n_Format == GZipFormat) {
+    archive_read_support_filter_gzip(archive.data());
+  } else {
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+    archive_read_support_filter_zstd(archive.data());
+#else
+    return false;
+#endif
+  }
+  archive_read_support_format_raw(archive.data());
+  if (archive_read_open_memory(archive.data(),
+                               const_cast<char*>(chunk->input.constData()),
+                               chunk->input.size()) != ARCHIVE_OK) {
+    return false;
+  }
+
+  struct archive_entry* entry = nullptr;
+  int ret = archive_read_next_header(archive.data(), &entry);
+  if (ret == ARCHIVE_EOF) {
+    return true;  // Only empty members, like the one ending BGZF files.
+  }
+  if (ret != ARCHIVE_OK) {
+    return false;
+  }
+  chunk->output.reserve(chunk->input.size() * 4);
+  const void* buffer;
+  size_t size;
+  int64_t offset;
+  while ((ret = archive_read_data_block(archive.data(), &buffer, &size,
+                                        &offset)) == ARCHIVE_OK) {
+    chunk->output.append(static_cast<const char*>(buffer),
+                         static_cast<int>(size));
+  }
+  return ret == ARCHIVE_EOF;
+}
@@ -0,0 +1,629 @@
+#include <QDateTime>
+#include <QFile>
+#include <QSharedPointer>
+#include <qarchive_enums.hpp>
+#include <qarchiveparallelzipwriter_p.hpp>
+#include <qarchiveutils_p.hpp>
+
+extern "C" {
+#include <archive.h>
+#include <archive_entry.h>
+}
+
+// Support older libarchive versions where la_ssize_t is not defined yet
+#if ARCHIVE_VERSION_NUMBER <= 3001002
+#define la_ssize_t __LA_SSIZE_T
+#endif
+
+using namespace QArchive;
+
+namespace {
+// Entries larger than this are deflated to a temporary file.
+constexpr qint64 SpillSize = 64 * 1024 * 1024;
+constexpr int ReadSize = 64 * 1024;
+
+// Enough of the start of a gzip stream to hold its header.
+constexpr int GZipHeadSize = 1024;
+
+// The central directory is written out once this much of it is pending.
+constexpr int DirectoryFlushSize = 1024 * 1024;
+
+constexpr quint32 LocalHeaderSignature = 0x04034B50;
+constexpr quint32 CentralHeaderSignature = 0x02014B50;
+constexpr quint32 EndOfDirectorySignature = 0x06054B50;
+constexpr quint32 Zip64EndOfDirectorySignature = 0x06064B50;
+constexpr quint32 Zip64LocatorSignature = 0x07064B50;
+constexpr quint16 Zip64ExtraId = 0x0001;
+constexpr quint16 TimestampExtraId = 0x5455;
+constexpr quint16 Utf8NameFlag = 0x0800;
+constexpr quint16 MadeByUnix = 3 << 8;
+constexpr quint32 Zip64Limit = 0xFFFFFFFF;
+
+void appendLE(QByteArray* out, quint64 value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out->append(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+quint32 readLE(const char* data, int bytes) {
+  quint32 value = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    value = (value << 8) | static_cast<uchar>(data[i]);
+  }
+  return value;
+}
+
+// The size of the header the gzip stream starts with, -1 if it is not one
+// or is cut short.
+qint64 getGZipHeaderSize(const QByteArray& head) {
+  if (head.size() < 10 || static_cast<uchar>(head[0]) != 0x1F ||
+      static_cast<uchar>(head[1]) != 0x8B || head[2] != 8) {
+    return -1;
+  }
+  const uchar flags = static_cast<uchar>(head[3]);
+  int pos = 10;
+  if (flags & 4) {
+    if (head.size() < pos + 2) {
+      return -1;
+    }
+    pos += 2 + static_cast<int>(readLE(head.constData() + pos, 2));
+  }
+  // The file name and the comment end with a NUL.
+  for (uchar flag : {uchar(8), uchar(16)}) {
+    if (flags & flag) {
+      const int end = head.indexOf('\0', pos);
+      if (end < 0) {
+        return -1;
+      }
+      pos = end + 1;
+    }
+  }
+  if (flags & 2) {
+    pos += 2;
+  }
+  return pos <= head.size() ? pos : -1;
+}
+
+// The MS-DOS date and time of the given time, in local time like libarchive
+// writes it. Times before 1980 cannot be represented and are clamped.
+quint32 toDosTime(qint64 secs) {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+  const QDateTime time = QDateTime::fromSecsSinceEpoch(secs);
+#else
+  const QDateTime time = QDateTime::fromTime_t(static_cast<uint>(secs));
+#endif
+  const QDate date = time.date();
+  const QTime clock = time.time();
+  if (date.year() < 1980) {
+    return (1 << 21) | (1 << 16);
+  }
+  return static_cast<quint32>(qMin(date.year() - 1980, 127)) << 25 |
+         static_cast<quint32>(date.month()) << 21 |
+         static_cast<quint32>(date.day()) << 16 |
+         static_cast<quint32>(clock.hour()) << 11 |
+         static_cast<quint32>(clock.minute()) << 5 |
+         static_cast<quint32>(clock.second() / 2);
+}
+
+// The CRC-32 of ZIP and gzip, continued from the given one over the data.
+quint32 updateCrc32(quint32 crc, const char* data, qint64 length) {
+  struct Table {
+    quint32 values[256];
+    Table() {
+      for (quint32 n = 0; n < 256; ++n) {
+        quint32 c = n;
+        for (int k = 0; k < 8; ++k) {
+          c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        }
+        values[n] = c;
+      }
+    }
+  };
+  static const Table table;
+  crc = ~crc;
+  for (qint64 i = 0; i < length; ++i) {
+    crc = table.values[(crc ^ static_cast<uchar>(data[i])) & 0xFF] ^
+          (crc >> 8);
+  }
+  return ~crc;
+}
+
+// The extended timestamp extra field, holding the modification time.
+void appendTimestamp(QByteArray* extra, qint64 mtime) {
+  appendLE(extra, TimestampExtraId, 2);
+  appendLE(extra, 5, 2);
+  extra->append(char(1));
+  appendLE(extra, static_cast<quint32>(mtime), 4);
+}
+
+// Collects the gzip stream of an entry in memory or in a temporary file,
+// keeping its start and its end around for the header and the trailer.
+struct Sink {
+  QByteArray* output = nullptr;
+  FILE* spill = nullptr;
+  QByteArray head;
+  QByteArray tail;
+  qint64 size = 0;
+};
+
+la_ssize_t writeSink(struct archive*, void* data, const void* buffer,
+                     size_t length) {
+  auto sink = static_cast<Sink*>(data);
+  auto bytes = static_cast<const char*>(buffer);
+  const int n = static_cast<int>(length);
+  if (sink->spill) {
+    if (fwrite(bytes, 1, length, sink->spill) != length) {
+      return -1;
+    }
+  } else {
+    sink->output->append(bytes, n);
+  }
+  if (sink->head.size() < GZipHeadSize) {
+    sink->head.append(bytes, qMin(n, GZipHeadSize - sink->head.size()));
+  }
+  sink->tail.append(bytes + qMax(0, n - 8), qMin(n, 8));
+  sink->tail = sink->tail.right(8);
+  sink->size += n;
+  return static_cast<la_ssize_t>(length);
+}
+}  // namespace
+
+ParallelZipWriter::Entry::~Entry() {
+  if (spill) {
+    fclose(spill);
+  }
+}
+
+ParallelZipWriter::ParallelZipWriter(QIODevice* device,
+                                     int threads,
+                                     int level)
+    : m_Device(device),
+      n_Level(level),
+      n_MaxEntries(4 * static_cast<size_t>(qMax(threads, 1))) {
+  for (int i = 0; i < qMax(threads, 1); ++i) {
+    m_Threads.emplace_back(&ParallelZipWriter::run, this);
+  }
+}
+
+ParallelZipWriter::~ParallelZipWriter() {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    b_Stop = true;
+  }
+  m_Condition.notify_all();
+  for (auto& thread : m_Threads) {
+    thread.join();
+  }
+}
+
+// The number of entries added but not written yet.
+size_t ParallelZipWriter::pending() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Entries.size();
+}
+
+// True when enough entries are pending to keep every thread busy.
+bool ParallelZipWriter::isFull() const {
+  return pending() >= n_MaxEntries;
+}
+
+// Adds a regular file, with the mode and modification time it was found
+// with so it is not stat'ed again.
+void ParallelZipWriter::addFile(const QString& entry,
+                                const QString& path,
+                                quint32 mode,
+                                qint64 mtime) {
+  auto e = std::make_shared<Entry>();
+  e->name = entry.toUtf8();
+  e->path = path;
+  e->mode = mode;
+  e->mtime = mtime;
+  submit(e);
+}
+
+void ParallelZipWriter::addData(const QString& entry, const QByteArray& data) {
+  auto e = std::make_shared<Entry>();
+  e->name = entry.toUtf8();
+  e->input = data;
+  e->mode = 0100644;
+  e->mtime = getSecsSinceEpoch(QDateTime::currentDateTime());
+  submit(e);
+}
+
+// Writes the next entry once it is deflated, giving the number of bytes it
+// held. Blocks until one of the threads is done with it.
+short ParallelZipWriter::writeNext(qint64* bytes) {
+  std::shared_ptr<Entry> entry;
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if (m_Entries.empty()) {
+      *bytes = 0;
+      return NoError;
+    }
+    m_Condition.wait(lock, [this]() { return m_Entries.front()->done; });
+    entry = m_Entries.front();
+    m_Entries.pop_front();
+  }
+  if (entry->error != NoError) {
+    return entry->error;
+  }
+  if (!writeEntry(entry.get())) {
+    return ArchiveFatalError;
+  }
+  *bytes = entry->size;
+  return NoError;
+}
+
+// Writes the entries left and the central directory which ends the archive.
+short ParallelZipWriter::finish() {
+  qint64 bytes = 0;
+  while (pending()) {
+    const short ret = writeNext(&bytes);
+    if (ret != NoError) {
+      return ret;
+    }
+  }
+
+  const qint64 directoryOffset = n_Offset;
+  QByteArray directory;
+  for (const auto& record : m_Records) {
+    const bool zip64Size =
+        record.size >= Zip64Limit || record.compressedSize >= Zip64Limit;
+    const bool zip64Offset = record.offset >= Zip64Limit;
+    const quint16 version = zip64Size || zip64Offset ? 45 : 20;
+
+    // The ZIP64 field only holds the values which do not fit the header.
+    QByteArray extra;
+    if (zip64Size || zip64Offset) {
+      QByteArray field;
+      if (zip64Size) {
+        appendLE(&field, record.size, 8);
+        appendLE(&field, record.compressedSize, 8);
+      }
+      if (zip64Offset) {
+        appendLE(&field, record.offset, 8);
+      }
+      appendLE(&extra, Zip64ExtraId, 2);
+      appendLE(&extra, field.size(), 2);
+      extra.append(field);
+    }
+    appendTimestamp(&extra, record.mtime);
+
+    appendLE(&directory, CentralHeaderSignature, 4);
+    appendLE(&directory, MadeByUnix | version, 2);
+    appendLE(&directory, version, 2);
+    appendLE(&directory, Utf8NameFlag, 2);
+    appendLE(&directory, record.method, 2);
+    appendLE(&directory, toDosTime(record.mtime), 4);
+    appendLE(&directory, record.crc, 4);
+    appendLE(&directory, zip64Size ? Zip64Limit : record.compressedSize, 4);
+    appendLE(&directory, zip64Size ? Zip64Limit : record.size, 4);
+    appendLE(&directory, record.name.size(), 2);
+    appendLE(&directory, extra.size(), 2);
+    appendLE(&directory, 0, 2);  // Comment length.
+    appendLE(&directory, 0, 2);  // Disk number.
+    appendLE(&directory, 0, 2);  // Internal attributes.
+    appendLE(&directory, static_cast<quint64>(record.mode) << 16, 4);
+    appendLE(&directory, zip64Offset ? Zip64Limit : record.offset, 4);
+    directory.append(record.name);
+    directory.append(extra);
+
+    if (directory.size() >= DirectoryFlushSize) {
+      if (!write(directory)) {
+        return ArchiveFatalError;
+      }
+      directory.clear();
+    }
+  }
+  if (!write(directory)) {
+    return ArchiveFatalError;
+  }
+
+  const quint64 entries = m_Records.size();
+  const qint64 directorySize = n_Offset - directoryOffset;
+  QByteArray end;
+  if (entries >= 0xFFFF || directoryOffset >= Zip64Limit ||
+      directorySize >= Zip64Limit) {
+    const qint64 zip64EndOffset = n_Offset;
+    appendLE(&end, Zip64EndOfDirectorySignature, 4);
+    appendLE(&end, 44, 8);  // The size of the rest of the record.
+    appendLE(&end, MadeByUnix | 45, 2);
+    appendLE(&end, 45, 2);
+    appendLE(&end, 0, 4);  // Disk number.
+    appendLE(&end, 0, 4);  // Disk of the central directory.
+    appendLE(&end, entries, 8);
+    appendLE(&end, entries, 8);
+    appendLE(&end, directorySize, 8);
+    appendLE(&end, directoryOffset, 8);
+
+    appendLE(&end, Zip64LocatorSignature, 4);
+    appendLE(&end, 0, 4);  // Disk of the ZIP64 end of central directory.
+    appendLE(&end, zip64EndOffset, 8);
+    appendLE(&end, 1, 4);  // Number of disks.
+  }
+  appendLE(&end, EndOfDirectorySignature, 4);
+  appendLE(&end, 0, 2);  // Disk number.
+  appendLE(&end, 0, 2);  // Disk of the central directory.
+  appendLE(&end, qMin<quint64>(entries, 0xFFFF), 2);
+  appendLE(&end, qMin<quint64>(entries, 0xFFFF), 2);
+  appendLE(&end, qMin<qint64>(directorySize, Zip64Limit), 4);
+  appendLE(&end, qMin<qint64>(directoryOffset, Zip64Limit), 4);
+  appendLE(&end, 0, 2);  // Comment length.
+  if (!write(end)) {
+    return ArchiveFatalError;
+  }
+  m_Records.clear();
+  return NoError;
+}
+
+void ParallelZipWriter::run() {
+  for (;;) {
+    std::shared_ptr<Entry> entry;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_Condition.wait(lock, [&]() {
+        for (auto& pending : m_Entries) {
+          if (!pending->started) {
+            entry = pending;
+            return true;
+          }
+        }
+        return b_Stop.load();
+      });
+      if (!entry) {
+        return;
+      }
+      entry->started = true;
+    }
+
+    const short ret = compress(entry.get());
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      entry->error = ret;
+      entry->done = true;
+      entry->input.clear();
+    }
+    m_Condition.notify_all();
+  }
+}
+
+void ParallelZipWriter::submit(const std::shared_ptr<Entry>& entry) {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Entries.push_back(entry);
+  }
+  m_Condition.notify_all();
+}
+
+// Deflates an entry through libarchive, as the single entry of a raw
+// archive with the gzip filter, and takes the deflate stream and its CRC
+// out of the gzip stream. Empty entries, and all of them at level 0, are
+// stored like libarchive does.
+short ParallelZipWriter::compress(Entry* entry) const {
+  std::unique_ptr<QFile> file;
+  if (!entry->path.isEmpty()) {
+    file.reset(new QFile(entry->path));
+    if (!file->open(QIODevice::ReadOnly)) {
+      return DiskOpenError;
+    }
+  }
+  const qint64 expected = file ? file->size() : entry->input.size();
+  if (expected == 0) {
+    entry->method = 0;
+    return NoError;
+  }
+  if (n_Level == 0) {
+    return store(entry, file.get(), expected);
+  }
+
+  Sink sink;
+  sink.output = &entry->output;
+  if (expected > SpillSize) {
+    entry->spill = std::tmpfile();
+    if (!entry->spill) {
+      return ArchiveFatalError;
+    }
+    sink.spill = entry->spill;
+  } else {
+    entry->output.reserve(static_cast<int>(expected / 2));
+  }
+
+  QSharedPointer<struct archive> archive(archive_write_new(),
+                                         ArchiveWriteDestructor);
+  if (!archive) {
+    return NotEnoughMemory;
+  }
+  archive_write_add_filter_gzip(archive.data());
+  if (n_Level >= 0) {
+    archive_write_set_filter_option(archive.data(), "gzip",
+                                    "compression-level",
+                                    QByteArray::number(n_Level).constData());
+  }
+#if ARCHIVE_VERSION_NUMBER >= 3002000
+  archive_write_set_filter_option(archive.data(), "gzip", "timestamp",
+                                  nullptr);
+#endif
+  archive_write_set_format_raw(archive.data());
+  archive_write_set_bytes_per_block(archive.data(), 0);
+  if (archive_write_open(archive.data(), &sink, nullptr, writeSink,
+                         nullptr) != ARCHIVE_OK) {
+    return ArchiveFatalError;
+  }
+
+  QSharedPointer<struct archive_entry> header(archive_entry_new(),
+                                              ArchiveEntryDestructor);
+  archive_entry_set_filetype(header.data(), AE_IFREG);
+  archive_entry_set_size(header.data(), expected);
+  if (archive_write_header(archive.data(), header.data()) != ARCHIVE_OK) {
+    return ArchiveFatalError;
+  }
+
+  if (file) {
+    QByteArray buffer(ReadSize, Qt::Uninitialized);
+    for (;;) {
+      const qint64 n = file->read(buffer.data(), buffer.size());
+      if (n < 0) {
+        return DiskReadError;
+      }
+      if (n == 0) {
+        break;
+      }
+      if (b_Stop ||
+          archive_write_data(archive.data(), buffer.constData(), n) != n) {
+        return ArchiveFatalError;
+      }
+      entry->size += n;
+    }
+  } else {
+    if (archive_write_data(archive.data(), entry->input.constData(),
+                           entry->input.size()) != entry->input.size()) {
+      return ArchiveFatalError;
+    }
+    entry->size = entry->input.size();
+  }
+  if (archive_write_close(archive.data()) != ARCHIVE_OK) {
+    return ArchiveFatalError;
+  }
+
+  const qint64 headerSize = getGZipHeaderSize(sink.head);
+  if (headerSize < 0 || sink.tail.size() != 8 ||
+      sink.size < headerSize + 8) {
+    return ArchiveFatalError;
+  }
+  entry->crc = readLE(sink.tail.constData(), 4);
+  entry->dataOffset = headerSize;
+  entry->compressedSize = sink.size - headerSize - 8;
+  entry->outputSize = sink.size;
+  return NoError;
+}
+
+// Copies an entry as it is, to memory or to a temporary file like a
+// deflated one, and computes its CRC on the way.
+short ParallelZipWriter::store(Entry* entry,
+                               QFile* file,
+                               qint64 expected) const {
+  entry->method = 0;
+  if (!file) {
+    entry->output = entry->input;
+    entry->size = entry->input.size();
+    entry->crc = updateCrc32(0, entry->input.constData(), entry->size);
+  } else {
+    if (expected > SpillSize) {
+      entry->spill = std::tmpfile();
+      if (!entry->spill) {
+        return ArchiveFatalError;
+      }
+    } else {
+      entry->output.reserve(static_cast<int>(expected));
+    }
+    QByteArray buffer(ReadSize, Qt::Uninitialized);
+    for (;;) {
+      const qint64 n = file->read(buffer.data(), buffer.size());
+      if (n < 0) {
+        return DiskReadError;
+      }
+      if (n == 0) {
+        break;
+      }
+      if (b_Stop) {
+        return ArchiveFatalError;
+      }
+      if (entry->spill) {
+        if (fwrite(buffer.constData(), 1, static_cast<size_t>(n),
+                   entry->spill) != static_cast<size_t>(n)) {
+          return ArchiveFatalError;
+        }
+      } else {
+        entry->output.append(buffer.constData(), static_cast<int>(n));
+      }
+      entry->crc = updateCrc32(entry->crc, buffer.constData(), n);
+      entry->size += n;
+    }
+  }
+  entry->dataOffset = 0;
+  entry->compressedSize = entry->size;
+  entry->outputSize = entry->size;
+  return NoError;
+}
+
+bool ParallelZipWriter::writeEntry(Entry* entry) {
+  const bool zip64 =
+      entry->size >= Zip64Limit || entry->compressedSize >= Zip64Limit;
+  QByteArray extra;
+  if (zip64) {
+    appendLE(&extra, Zip64ExtraId, 2);
+    appendLE(&extra, 16, 2);
+    appendLE(&extra, entry->size, 8);
+    appendLE(&extra, entry->compressedSize, 8);
+  }
+  appendTimestamp(&extra, entry->mtime);
+
+  QByteArray header;
+  appendLE(&header, LocalHeaderSignature, 4);
+  appendLE(&header, zip64 ? 45 : 20, 2);
+  appendLE(&header, Utf8NameFlag, 2);
+  appendLE(&header, entry->method, 2);
+  appendLE(&header, toDosTime(entry->mtime), 4);
+  appendLE(&header, entry->crc, 4);
+  appendLE(&header, zip64 ? Zip64Limit : entry->compressedSize, 4);
+  appendLE(&header, zip64 ? Zip64Limit : entry->size, 4);
+  appendLE(&header, entry->name.size(), 2);
+  appendLE(&header, extra.size(), 2);
+  header.append(entry->name);
+  header.append(extra);
+
+  const Record record{entry->name,          entry->mode, entry->mtime,
+                      entry->crc,           entry->method, entry->size,
+                      entry->compressedSize, n_Offset};
+  if (!write(header) || !writeData(entry)) {
+    return false;
+  }
+  m_Records.push_back(record);
+  return true;
+}
+
+// Writes the deflate stream of an entry, which sits between the header and
+// the trailer of its gzip stream, or the stored entry as it is.
+bool ParallelZipWriter::writeData(const Entry* entry) {
+  if (!entry->compressedSize) {
+    return true;
+  }
+  if (!entry->spill) {
+    return write(QByteArray::fromRawData(
+        entry->output.constData() + entry->dataOffset,
+        static_cast<int>(entry->compressedSize)));
+  }
+
+  rewind(entry->spill);
+  QByteArray buffer(ReadSize, Qt::Uninitialized);
+  qint64 skip = entry->dataOffset;
+  qint64 left = entry->compressedSize;
+  while (skip > 0 || left > 0) {
+    const size_t want = static_cast<size_t>(
+        skip > 0 ? qMin<qint64>(skip, ReadSize) : qMin<qint64>(left, ReadSize));
+    if (fread(buffer.data(), 1, want, entry->spill) != want) {
+      return false;
+    }
+    if (skip > 0) {
+      skip -= want;
+      continue;
+    }
+    if (!write(QByteArray::fromRawData(buffer.constData(),
+                                       static_cast<int>(want)))) {
+      return false;
+    }
+    left -= want;
+  }
+  return true;
+}
+
+bool ParallelZipWriter::write(const QByteArray& data) {
+  if (data.isEmpty()) {
+    return true;
+  }
+  if (m_Device->write(data) != data.size()) {
+    return false;
+  }
+  n_Offset += data.size();
+  return true;
+}
@@ -1,8 +1,15 @@
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFileInfo>
 #include <QIODevice>
 #include <QString>
+#include <qarchive_enums.hpp>
 #include <qarchiveioreader_p.hpp>
+#include <qarchiveparallelfilter_p.hpp>
 #include <qarchiveutils_p.hpp>
 
+#include <utility>
+
 extern "C" {
 #include <archive.h>
 #include <archive_entry.h>
@@ -67,8 +74,8 @@ int archive_open_cb(struct archive*, void* data) {
     // any further.
     return ARCHIVE_FATAL;
   }
-  if (!p->second->isOpen() || !p->second->isReadable() || !(p->first) ||
-      p->second->isSequential()) {
+  if (!p->second->isOpen() || !p->second->isReadable() ||
+      !(p->first || p->second->isMemoryBacked())) {
     return ARCHIVE_FATAL;
   }
   return ARCHIVE_OK;
@@ -92,8 +99,7 @@ int archive_close_cb(struct archive*, void* data) {
 // to read the data from QIODevice.
 la_ssize_t archive_read_cb(struct archive*, void* data, const void** buffer) {
   auto p = static_cast<ClientData_t*>(data);
-  *buffer = p->first;
-  return p->second->read(p->first);
+  return p->second->read(buffer, p->first);
 }
 
 // This is the most important callback function required for libarchive to work with
@@ -107,6 +113,14 @@ int64_t archive_seek_cb(struct archive*, void* data, int64_t request,
   auto p = static_cast<ClientData_t*>(data);
   return static_cast<int64_t>(p->second->seek(request, whence));
 }
+
+// Called when libarchive does not need the next bytes, such as the data of
+// entries which are not extracted or when only listing. Without it
+// libarchive reads the data and throws it away.
+int64_t archive_skip_cb(struct archive*, void* data, int64_t request) {
+  auto p = static_cast<ClientData_t*>(data);
+  return static_cast<int64_t>(p->second->skip(request));
+}
 /* ---- */
 
 /*
@@ -138,25 +152,89 @@ la_ssize_t archive_write_cb(struct archive*, void* data, const void* buffer,
   auto p = static_cast<QIODevice*>(data);
   return p->write(static_cast<const char*>(buffer), length);
 }
+
+/*
+ * Custom libarchive callbacks to compress the archive output on a pool of
+ * threads before it goes to a QIODevice. */
+
+// The writer along with whether the device is closed with the archive.
+using ParallelClientData_t = std::pair<QArchive::ParallelFilterWriter*, bool>;
+
+int archive_parallel_open_cb(struct archive*, void* data) {
+  auto p = static_cast<ParallelClientData_t*>(data);
+  auto device = p->first->device();
+  if (!device) {
+    return ARCHIVE_FATAL;
+  }
+  if (!device->isOpen() && !device->open(QIODevice::WriteOnly)) {
+    return ARCHIVE_FATAL;
+  }
+  return ARCHIVE_OK;
+}
+
+la_ssize_t archive_parallel_write_cb(struct archive*, void* data,
+                                     const void* buffer, size_t length) {
+  auto p = static_cast<ParallelClientData_t*>(data);
+  if (!p->first->write(static_cast<const char*>(buffer), length)) {
+    return -1;
+  }
+  return static_cast<la_ssize_t>(length);
+}
+
+int archive_parallel_close_cb(struct archive*, void* data) {
+  auto p = static_cast<ParallelClientData_t*>(data);
+  const bool finished = p->first->finish();
+  if (p->second) {
+    p->first->device()->close();
+  }
+  delete p->first;  // Waits for the threads.
+  delete p;
+  return finished ? ARCHIVE_OK : ARCHIVE_FATAL;
+}
 }  // namespace
 
 // This is a custom functions which sets up the callbacks and other
 // stuff for a libarchive struct.
 int archiveReadOpenQIODevice(struct archive* archive, int blocksize,
                              QIODevice* device) {
+  return archiveReadOpenQIODevice(archive, blocksize, device,
+                                  QArchive::IOReaderOptions());
+}
+
+int archiveReadOpenQIODevice(struct archive* archive, int blocksize,
+                             QIODevice* device,
+                             const QArchive::IOReaderOptions& options) {
   // This client data will be freed on close ,
   // we don't need to worry about this.
   auto p = static_cast<ClientData_t*>(calloc(1, sizeof(ClientData_t)));
   p->second = new QArchive::IOReaderPrivate;
+  p->second->setDropPageCache(options.dropPageCache);
+  p->second->setReadAhead(options.readAheadBlocks);
+  p->second->setFollowTimeout(options.followTimeout);
+  p->second->setSequentialTimeout(options.sequentialTimeout);
+  p->second->setCancelFlag(options.cancelRequested);
+  p->second->setPauseFlag(options.pauseRequested);
+  p->second->setBlockCache(options.cacheBlocks);
   p->second->setIODevice(device);
   p->second->setBlockSize(blocksize);
-  p->first = static_cast<char*>(
-      calloc(1, (blocksize < 1024) ? sizeof(*(p->first)) * 10204
-                                   : sizeof(*(p->first)) * blocksize));
+  p->second->setStatistics(options.statistics);
+  // Devices backed by memory are read in place and need no buffer. Every
+  // read fills the buffer before libarchive looks at it, so it is not
+  // cleared, which for a block of a file cost more than opening a small
+  // archive.
+  if (!p->second->isMemoryBacked()) {
+    p->first = static_cast<char*>(malloc(p->second->blockSize()));
+  }
 
   archive_read_set_open_callback(archive, archive_open_cb);
   archive_read_set_read_callback(archive, archive_read_cb);
-  archive_read_set_seek_callback(archive, archive_seek_cb);
+  // Sequential devices and files which are still growing can only be read
+  // through, without a seek callback libarchive sticks to the formats and
+  // modes which can be streamed.
+  if (options.followTimeout == 0 && (!device || !device->isSequential())) {
+    archive_read_set_seek_callback(archive, archive_seek_cb);
+  }
+  archive_read_set_skip_callback(archive, archive_skip_cb);
   archive_read_set_close_callback(archive, archive_close_cb);
   archive_read_set_callback_data(archive, p);
   return archive_read_open1(archive);
@@ -176,8 +254,53 @@ int archiveWriteOpenQIODevice(struct archive* archive, QIODevice* device) {
                              [](struct archive*, void*) { return ARCHIVE_OK; });
 #endif
 }
+
+// Opens the archive to write to the device through a ParallelFilterWriter,
+// the archive itself must not have a filter. The device is closed with the
+// archive if asked to, a QSaveFile must not be.
+int archiveWriteOpenParallelFilter(struct archive* archive, QIODevice* device,
+                                   short format, int threads, int level,
+                                   bool closeDevice) {
+  auto p = new ParallelClientData_t(
+      new QArchive::ParallelFilterWriter(device, format, threads, level),
+      closeDevice);
+  return archive_write_open(archive, p, archive_parallel_open_cb,
+                            archive_parallel_write_cb,
+                            archive_parallel_close_cb);
+}
 /* ---- */
 
+qint64 getSecsSinceEpoch(const QDateTime& time) {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+  return time.toSecsSinceEpoch();
+#else
+  return time.toTime_t();
+#endif
+}
+
+// The st_mode of a file or directory from what QFileInfo knows about it,
+// for where there is no stat. Other file types only get the permissions.
+quint32 getUnixMode(const QFileInfo& info) {
+  static const struct {
+    QFileDevice::Permission permission;
+    quint32 bit;
+  } bits[] = {
+      {QFileDevice::ReadOwner, 0400}, {QFileDevice::WriteOwner, 0200},
+      {QFileDevice::ExeOwner, 0100},  {QFileDevice::ReadGroup, 040},
+      {QFileDevice::WriteGroup, 020}, {QFileDevice::ExeGroup, 010},
+      {QFileDevice::ReadOther, 04},   {QFileDevice::WriteOther, 02},
+      {QFileDevice::ExeOther, 01},
+  };
+  quint32 mode = info.isDir() ? 0040000 : info.isFile() ? 0100000 : 0;
+  const auto permissions = info.permissions();
+  for (const auto& bit : bits) {
+    if (permissions & bit.permission) {
+      mode |= bit.bit;
+    }
+  }
+  return mode;
+}
+
 /*
  * This function returns an allocated c string which is the combination
  * of the given c strings.
@@ -207,12 +330,139 @@ QString getDirectoryFileName(const QString& dir) {
   return dir;
 }
 
+void EventLoopPump::setInterval(int ms) {
+  n_Interval = ms < 0 ? 0 : ms;
+}
+
+int EventLoopPump::interval() const {
+  return n_Interval;
+}
+
+void EventLoopPump::pump() {
+  if (n_Interval > 0 && m_Timer.isValid() && m_Timer.elapsed() < n_Interval) {
+    return;
+  }
+  QCoreApplication::processEvents();
+  m_Timer.start();
+}
+
+void ProgressThrottle::setInterval(int ms) {
+  n_Interval = ms < 0 ? 0 : ms;
+}
+
+void ProgressThrottle::setMinimumBytes(qint64 bytes) {
+  n_MinimumBytes = bytes < 0 ? 0 : bytes;
+}
+
+void ProgressThrottle::setPerEntryOnly(bool enabled) {
+  b_PerEntryOnly = enabled;
+}
+
+// Forgets the last emitted update, called when an operation starts.
+void ProgressThrottle::reset() {
+  n_LastBytes = 0;
+  b_Pending = false;
+  m_Timer.invalidate();
+}
+
+// Returns true if the update with the given processed bytes has to be
+// emitted, entryDone is set for the update at the end of an entry.
+bool ProgressThrottle::pass(qint64 bytesProcessed, bool entryDone) {
+  if (b_PerEntryOnly && !entryDone) {
+    return false;
+  }
+  if ((n_Interval > 0 && m_Timer.isValid() && m_Timer.elapsed() < n_Interval) ||
+      (n_MinimumBytes > 0 && bytesProcessed - n_LastBytes < n_MinimumBytes)) {
+    b_Pending = true;
+    return false;
+  }
+  n_LastBytes = bytesProcessed;
+  b_Pending = false;
+  m_Timer.start();
+  return true;
+}
+
+bool ProgressThrottle::hasPending() const {
+  return b_Pending;
+}
+
+// Returns true if the given string has any non ASCII characters, which
+// are then taken as UTF-8.
 bool isUTF8(const char* src) {
-  auto s = QString::fromUtf8(src);
-  auto latin1 = QString::fromLatin1(src);
+  return src && !isASCII(src, strlen(src));
+}
+
+namespace {
+// Checks 8 bytes at once for a byte with the high bit set.
+inline bool hasNonASCIIWord(const unsigned char* src) {
+  quint64 word;
+  memcpy(&word, src, sizeof(word));
+  return (word & Q_UINT64_C(0x8080808080808080)) != 0;
+}
+}  // namespace
+
+bool isASCII(const char* src, size_t length) {
+  auto s = reinterpret_cast<const unsigned char*>(src);
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    if (hasNonASCIIWord(s + i)) {
+      return false;
+    }
+  }
+  for (; i < length; ++i) {
+    if (s[i] & 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  // Latin1 converts utf8 chars to ?
-  // so we can easily check if the string has
-  // utf8 characters
-  return s != latin1;
+// Returns true if the given bytes are well formed UTF-8, overlong forms,
+// surrogates and code points above U+10FFFF are rejected.
+bool isValidUTF8(const char* src, size_t length) {
+  static const quint32 minimum[] = {0, 0x80, 0x800, 0x10000};
+  auto s = reinterpret_cast<const unsigned char*>(src);
+  size_t i = 0;
+  while (i < length) {
+    if (s[i] < 0x80) {
+      // Skip runs of ASCII a word at a time.
+      while (i + 8 <= length && !hasNonASCIIWord(s + i)) {
+        i += 8;
+      }
+      while (i < length && s[i] < 0x80) {
+        ++i;
+      }
+      continue;
+    }
+
+    size_t n = 0;
+    quint32 codePoint = 0;
+    if ((s[i] & 0xE0) == 0xC0) {
+      n = 1;
+      codePoint = s[i] & 0x1F;
+    } else if ((s[i] & 0xF0) == 0xE0) {
+      n = 2;
+      codePoint = s[i] & 0x0F;
+    } else if ((s[i] & 0xF8) == 0xF0) {
+      n = 3;
+      codePoint = s[i] & 0x07;
+    } else {
+      return false;
+    }
+    if (i + n >= length) {
+      return false;
+    }
+    for (size_t k = 1; k <= n; ++k) {
+      if ((s[i + k] & 0xC0) != 0x80) {
+        return false;
+      }
+      codePoint = (codePoint << 6) | (s[i + k] & 0x3F);
+    }
+    if (codePoint < minimum[n] || codePoint > 0x10FFFF ||
+        (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+      return false;
+    }
+    i += n + 1;
+  }
+  return true;
 }
@@ -1,5 +1,51 @@
 #include <QArchiveDiskCompressorTests.hpp>
 
+#include <QBuffer>
+
+namespace {
+/* Writes text-like input of the given size, unless it is already there. */
+bool writeTextInput(const QString& path, qint64 size) {
+  if (QFileInfo(path).size() == size) {
+    return true;
+  }
+  QFile input(path);
+  if (!input.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  const char* words[] = {"archive ", "block ",  "core ",  "data ",
+                         "entry ",   "filter ", "group ", "header "};
+  QByteArray text;
+  quint32 seed = 1;
+  while (text.size() < size) {
+    seed = seed * 1103515245 + 12345;
+    text.append(words[(seed >> 16) % 8]);
+  }
+  text.truncate(size);
+  return input.write(text) == size;
+}
+
+quint64 readLE(const QByteArray& data, int pos, int bytes) {
+  quint64 value = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    value = (value << 8) | static_cast<uchar>(data[pos + i]);
+  }
+  return value;
+}
+
+/* The end of central directory record which ends a ZIP archive without a
+ * comment, with the ZIP64 locator and record in front of it if there are
+ * any, empty if the archive is not there. */
+QByteArray readZipEnd(const QString& path) {
+  QFile archive(path);
+  if (!archive.open(QIODevice::ReadOnly) || archive.size() < 22) {
+    return {};
+  }
+  const qint64 size = qMin<qint64>(archive.size(), 22 + 20 + 56);
+  archive.seek(archive.size() - size);
+  return archive.read(size);
+}
+}  // namespace
+
 void QArchiveDiskCompressorTests::initTestCase() {
   if (TestCasesDir.isEmpty()) {
     QFAIL("Temporary directory failed to construct.");
@@ -280,6 +326,510 @@ void QArchiveDiskCompressorTests::compressMultiLevelSpecialCharacterFiles() {
   QVERIFY(QFileInfo::exists(TestCase10ArchivePath));
 }
 
+void QArchiveDiskCompressorTests::compressingWithThreads_data() {
+  QTest::addColumn<short>("format");
+  QTest::newRow("xz") << short(QArchive::XzFormat);
+  QTest::newRow("zstd") << short(QArchive::ZstdFormat);
+}
+
+void QArchiveDiskCompressorTests::compressingWithThreads() {
+  QFETCH(short, format);
+
+  const qint64 inputSize = 2 * 1024 * 1024;
+  const QString inputPath = TestOutputDir + "ThreadedRoundTrip.txt";
+  const QString archivePath = TestOutputDir + "ThreadedRoundTrip.tar";
+  const QString outputDir = TestOutputDir + "ThreadedRoundTrip";
+  QVERIFY(writeTextInput(inputPath, inputSize));
+  QFile::remove(archivePath);
+  QDir(outputDir).removeRecursively();
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskCompressor e(archivePath, format);
+  e.setThreads(4);
+  e.addFiles(QFileInfo(inputPath).fileName(), inputPath);
+  QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                   &QArchiveDiskCompressorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+  QVERIFY(spyInfo.wait(60000) || spyInfo.count());
+
+  /* The archive extracts to the same bytes it was made of. */
+  QArchive::DiskExtractor x(archivePath, outputDir);
+  QSignalSpy extractorSpy(&x, SIGNAL(finished()));
+  x.start();
+  QVERIFY(extractorSpy.wait(60000) || extractorSpy.count());
+
+  QFile input(inputPath);
+  QVERIFY((input.open(QIODevice::ReadOnly)) == true);
+  QFile output(outputDir + "/" + QFileInfo(inputPath).fileName());
+  QVERIFY((output.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(output.readAll() == input.readAll());
+}
+
+void QArchiveDiskCompressorTests::benchmarkThreadedCompression_data() {
+  QTest::addColumn<short>("format");
+  QTest::addColumn<int>("threads");
+  for (int threads : {1, 2, 4, 0}) {
+    QTest::newRow(qPrintable(QString("xz, %1 threads").arg(threads)))
+        << short(QArchive::XzFormat) << threads;
+    QTest::newRow(qPrintable(QString("zstd, %1 threads").arg(threads)))
+        << short(QArchive::ZstdFormat) << threads;
+  }
+}
+
+void QArchiveDiskCompressorTests::benchmarkThreadedCompression() {
+  QARCHIVE_SKIP_UNLESS_BENCHMARKING();
+  QFETCH(short, format);
+  QFETCH(int, threads);
+
+  /* Text-like input large enough to be split into several xz blocks. */
+  const qint64 inputSize = 64 * 1024 * 1024;
+  const QString inputPath = TestOutputDir + "ThreadedInput.txt";
+  const QString archivePath = TestOutputDir + "Threaded.tar";
+  QVERIFY(writeTextInput(inputPath, inputSize));
+
+  QBENCHMARK {
+    QFile::remove(archivePath);
+    QArchive::DiskCompressor e(archivePath, format);
+    e.setThreads(threads);
+    e.addFiles(QFileInfo(inputPath).fileName(), inputPath);
+    QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                     &QArchiveDiskCompressorTests::defaultErrorHandler);
+    QSignalSpy spyInfo(&e, SIGNAL(finished()));
+    e.start();
+
+    QVERIFY(spyInfo.wait(600000) || spyInfo.count());
+  }
+  QVERIFY(QFileInfo::exists(archivePath));
+  QFile::remove(archivePath);
+  QFile::remove(inputPath);
+}
+
+void QArchiveDiskCompressorTests::compressingWithCompressionLevel() {
+  QFile TestOutput(TemporaryFilePath);
+  QVERIFY((TestOutput.open(QIODevice::WriteOnly)) == true);
+  TestOutput.write(Test1OutputContents.toUtf8());
+  TestOutput.close();
+
+  /* The level reaches the gzip filter, the best level compresses the same
+   * input to less than the fastest one. */
+  const QString inputPath = TestOutputDir + "LevelTest.txt";
+  QVERIFY(writeTextInput(inputPath, 1024 * 1024));
+  qint64 sizes[2] = {0, 0};
+  for (int i = 0; i < 2; ++i) {
+    const int level = i ? 9 : 1;
+    const QString archivePath =
+        TestOutputDir + QString("Level%1.tar.gz").arg(level);
+    QFile::remove(archivePath);
+    QArchive::DiskCompressor e(archivePath);
+    e.setCompressionLevel(level);
+    e.addFiles(QFileInfo(inputPath).fileName(), inputPath);
+    QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                     &QArchiveDiskCompressorTests::defaultErrorHandler);
+    QSignalSpy spyInfo(&e, SIGNAL(finished()));
+    e.start();
+
+    /*  Must emit exactly one signal. */
+    QVERIFY(spyInfo.wait() || spyInfo.count());
+    QVERIFY(QFileInfo::exists(archivePath));
+    sizes[i] = QFileInfo(archivePath).size();
+  }
+  QVERIFY(sizes[1] < sizes[0]);
+
+  /* A level out of the range of the format is refused on start. */
+  const QString tarPath = TestOutputDir + "Level.tar";
+  QArchive::DiskCompressor t(tarPath);
+  t.setCompressionLevel(5);
+  t.addFiles(QFileInfo(Test1OutputFile).fileName(), TemporaryFilePath);
+  QSignalSpy tarErrorSpy(&t, SIGNAL(error(short, QString)));
+  t.start();
+
+  QVERIFY(tarErrorSpy.wait() || tarErrorSpy.count());
+  QCOMPARE(tarErrorSpy.takeFirst().at(0).toInt(),
+           int(QArchive::InvalidCompressionOption));
+  QVERIFY(!QFileInfo::exists(tarPath));
+
+  /* So are options libarchive does not know. */
+  const QString xzPath = TestOutputDir + "Options.tar.xz";
+  QArchive::DiskCompressor x(xzPath);
+  x.setFilterOptions("xz:no-such-option=1");
+  x.addFiles(QFileInfo(Test1OutputFile).fileName(), TemporaryFilePath);
+  QSignalSpy xzErrorSpy(&x, SIGNAL(error(short, QString)));
+  x.start();
+
+  QVERIFY(xzErrorSpy.wait() || xzErrorSpy.count());
+  QCOMPARE(xzErrorSpy.takeFirst().at(0).toInt(),
+           int(QArchive::InvalidCompressionOption));
+}
+
+void QArchiveDiskCompressorTests::compressingDirectoryTree() {
+  const QString inputDir = TestOutputDir + "Tree";
+  const QStringList files = {"a.txt", ".hidden", "Sub/b.txt",
+                             "Sub/Deeper/c.txt", "Other/d.txt"};
+  for (const auto& file : files) {
+    QVERIFY(QDir().mkpath(QFileInfo(inputDir + "/" + file).path()));
+    QFile input(inputDir + "/" + file);
+    QVERIFY((input.open(QIODevice::WriteOnly)) == true);
+    input.write(file.toUtf8());
+  }
+
+  const QString archivePath = TestOutputDir + "Tree.zip";
+  QFile::remove(archivePath);
+  QArchive::DiskCompressor e(archivePath);
+  e.setThreads(4);
+  e.addFiles("Tree", inputDir);
+  QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                   &QArchiveDiskCompressorTests::defaultErrorHandler);
+  QSignalSpy progressSpy(
+      &e, SIGNAL(progress(QString, int, int, qint64, qint64)));
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  /* Every file is found once, directory by directory. */
+  QStringList entries;
+  for (const auto& args : progressSpy) {
+    if (!entries.contains(args.at(0).toString())) {
+      entries << args.at(0).toString();
+    }
+  }
+  QCOMPARE(entries, QStringList({"Tree/.hidden", "Tree/a.txt",
+                                 "Tree/Other/d.txt", "Tree/Sub/b.txt",
+                                 "Tree/Sub/Deeper/c.txt"}));
+  QCOMPARE(progressSpy.last().at(4).toLongLong(),
+           qint64(files.join(QString()).toUtf8().size()));
+
+  const QString outputDir = TestOutputDir + "TreeOutput";
+  QVERIFY(QDir().mkpath(outputDir));
+  QArchive::DiskExtractor x(archivePath, outputDir);
+  QSignalSpy extractorSpy(&x, SIGNAL(finished()));
+  x.start();
+
+  QVERIFY(extractorSpy.wait() || extractorSpy.count());
+  for (const auto& file : files) {
+    QFile output(outputDir + "/Tree/" + file);
+    QVERIFY((output.open(QIODevice::ReadOnly)) == true);
+    QCOMPARE(QString(output.readAll()), file);
+  }
+}
+
+void QArchiveDiskCompressorTests::compressingDirectoryTreeWithLinks() {
+#ifndef Q_OS_UNIX
+  QSKIP("Symbolic links to directories need a Unix file system.");
+#endif
+  /* The directory is reached both as itself and through a link sorted
+   * before it, and has a link back to the tree in it. */
+  const QString inputDir = TestOutputDir + "LinkTree";
+  QDir(inputDir).removeRecursively();
+  QVERIFY(QDir().mkpath(inputDir + "/Real"));
+  for (const auto& file : {QString("top.txt"), QString("Real/x.txt")}) {
+    QFile input(inputDir + "/" + file);
+    QVERIFY((input.open(QIODevice::WriteOnly)) == true);
+    input.write(file.toUtf8());
+  }
+  QVERIFY(QFile::link(inputDir + "/Real", inputDir + "/Alias"));
+  QVERIFY(QFile::link(inputDir, inputDir + "/Real/Loop"));
+
+  /* The loop is not followed and the directory is listed once, under the
+   * name the walk reaches first, however the threads are scheduled. */
+  const QString archivePath = TestOutputDir + "LinkTree.zip";
+  for (int run = 0; run < 5; ++run) {
+    QFile::remove(archivePath);
+    QArchive::DiskCompressor e(archivePath);
+    e.setThreads(4);
+    e.addFiles("LinkTree", inputDir);
+    QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                     &QArchiveDiskCompressorTests::defaultErrorHandler);
+    QSignalSpy progressSpy(
+        &e, SIGNAL(progress(QString, int, int, qint64, qint64)));
+    QSignalSpy spyInfo(&e, SIGNAL(finished()));
+    e.start();
+
+    /*  Must emit exactly one signal. */
+    QVERIFY(spyInfo.wait() || spyInfo.count());
+
+    QStringList entries;
+    for (const auto& args : progressSpy) {
+      if (!entries.contains(args.at(0).toString())) {
+        entries << args.at(0).toString();
+      }
+    }
+    QCOMPARE(entries,
+             QStringList({"LinkTree/top.txt", "LinkTree/Alias/x.txt"}));
+  }
+  QFile::remove(archivePath);
+  QDir(inputDir).removeRecursively();
+}
+
+void QArchiveDiskCompressorTests::compressingZipWithThreads() {
+  /* Small files, an empty one and one large enough to be deflated to a
+   * temporary file, next to an entry in memory. */
+  const QString inputDir = TestOutputDir + "ZipThreads";
+  const QString outputDir = TestOutputDir + "ZipThreadsOutput";
+  const QString archivePath = TestOutputDir + "ZipThreads.zip";
+  const QStringList files = {"a.txt", "Empty.txt", "Large.txt", "Sub/b.txt"};
+  QVERIFY(QDir().mkpath(inputDir + "/Sub"));
+  QVERIFY(writeTextInput(inputDir + "/a.txt", 100 * 1024));
+  QFile empty(inputDir + "/Empty.txt");
+  QVERIFY((empty.open(QIODevice::WriteOnly)) == true);
+  empty.close();
+  QVERIFY(writeTextInput(inputDir + "/Large.txt", 65 * 1024 * 1024 + 1));
+  QVERIFY(writeTextInput(inputDir + "/Sub/b.txt", 1));
+  QFile::remove(archivePath);
+  QDir(outputDir).removeRecursively();
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QBuffer memory;
+  memory.setData("entry kept in memory");
+  QVERIFY((memory.open(QIODevice::ReadOnly)) == true);
+
+  QArchive::DiskCompressor e(archivePath, QArchive::ZipFormat);
+  e.setThreads(4);
+  e.addFiles("ZipThreads", inputDir);
+  e.addFiles("Memory.txt", &memory);
+  QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                   &QArchiveDiskCompressorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+  QVERIFY(spyInfo.wait(60000) || spyInfo.count());
+
+  /* The entries are written by the threads and not by libarchive, which
+   * would set the data descriptor flag as it writes without seeking. */
+  QFile archive(archivePath);
+  QVERIFY((archive.open(QIODevice::ReadOnly)) == true);
+  const QByteArray head = archive.read(8);
+  QCOMPARE(readLE(head, 0, 4), quint64(0x04034B50));
+  QCOMPARE(readLE(head, 6, 2), quint64(0x0800));
+  archive.close();
+
+  const QByteArray end = readZipEnd(archivePath).right(22);
+  QCOMPARE(readLE(end, 0, 4), quint64(0x06054B50));
+  QCOMPARE(readLE(end, 10, 2), quint64(files.size() + 1));
+
+  QArchive::DiskExtractor x(archivePath, outputDir);
+  QSignalSpy extractorSpy(&x, SIGNAL(finished()));
+  x.start();
+  QVERIFY(extractorSpy.wait(60000) || extractorSpy.count());
+
+  for (const auto& file : files) {
+    QFile input(inputDir + "/" + file);
+    QVERIFY((input.open(QIODevice::ReadOnly)) == true);
+    QFile output(outputDir + "/ZipThreads/" + file);
+    QVERIFY((output.open(QIODevice::ReadOnly)) == true);
+    QVERIFY(output.readAll() == input.readAll());
+  }
+  QFile output(outputDir + "/Memory.txt");
+  QVERIFY((output.open(QIODevice::ReadOnly)) == true);
+  QCOMPARE(output.readAll(), memory.data());
+  QDir(outputDir).removeRecursively();
+  QFile::remove(archivePath);
+}
+
+void QArchiveDiskCompressorTests::compressingStoredZipWithThreads() {
+  const QString inputPath = TestOutputDir + "Stored.txt";
+  const QString outputDir = TestOutputDir + "StoredOutput";
+  const QString archivePath = TestOutputDir + "Stored.zip";
+  const qint64 inputSize = 100 * 1024;
+  QVERIFY(writeTextInput(inputPath, inputSize));
+  QFile::remove(archivePath);
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskCompressor e(archivePath, QArchive::ZipFormat);
+  e.setThreads(2);
+  e.setCompressionLevel(0);
+  e.addFiles(QFileInfo(inputPath).fileName(), inputPath);
+  QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                   &QArchiveDiskCompressorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+  QVERIFY(spyInfo.wait(60000) || spyInfo.count());
+
+  /* Level 0 stores the entry like libarchive does, method 0 with both
+   * sizes the same, instead of deflating it with stored blocks. */
+  QFile archive(archivePath);
+  QVERIFY((archive.open(QIODevice::ReadOnly)) == true);
+  const QByteArray head = archive.read(30);
+  QCOMPARE(readLE(head, 0, 4), quint64(0x04034B50));
+  QCOMPARE(readLE(head, 8, 2), quint64(0));
+  QCOMPARE(readLE(head, 18, 4), quint64(inputSize));
+  QCOMPARE(readLE(head, 22, 4), quint64(inputSize));
+  archive.close();
+
+  /* libarchive checks the CRC as it extracts. */
+  QArchive::DiskExtractor x(archivePath, outputDir);
+  QSignalSpy extractorSpy(&x, SIGNAL(finished()));
+  x.start();
+  QVERIFY(extractorSpy.wait(60000) || extractorSpy.count());
+
+  QFile input(inputPath);
+  QVERIFY((input.open(QIODevice::ReadOnly)) == true);
+  QFile output(outputDir + "/" + QFileInfo(inputPath).fileName());
+  QVERIFY((output.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(output.readAll() == input.readAll());
+  QDir(outputDir).removeRecursively();
+  QFile::remove(archivePath);
+}
+
+void QArchiveDiskCompressorTests::compressingZipWithManyEntries() {
+  QARCHIVE_SKIP_UNLESS_LARGE_TESTS();
+
+  /* More entries than the end of central directory record can count. */
+  const int entries = 0x10000;
+  const QString archivePath = TestOutputDir + "ManyEntries.zip";
+  const QString outputDir = TestOutputDir + "ManyEntriesOutput";
+  QFile::remove(archivePath);
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QObject buffers;
+  QArchive::DiskCompressor e(archivePath, QArchive::ZipFormat);
+  e.setThreads(4);
+  for (int i = 0; i < entries; ++i) {
+    auto buffer = new QBuffer(&buffers);
+    buffer->setData(QByteArray::number(i));
+    buffer->open(QIODevice::ReadOnly);
+    e.addFiles(QString("Entry%1.txt").arg(i), buffer);
+  }
+  QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                   &QArchiveDiskCompressorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+  QVERIFY(spyInfo.wait(600000) || spyInfo.count());
+
+  /* The record counts 0xFFFF entries and the ZIP64 record the rest. */
+  const QByteArray end = readZipEnd(archivePath);
+  QCOMPARE(end.size(), 22 + 20 + 56);
+  QCOMPARE(readLE(end, 0, 4), quint64(0x06064B50));
+  QCOMPARE(readLE(end, 32, 8), quint64(entries));
+  QCOMPARE(readLE(end, 56, 4), quint64(0x07064B50));
+  QCOMPARE(readLE(end, 76, 4), quint64(0x06054B50));
+  QCOMPARE(readLE(end, 86, 2), quint64(0xFFFF));
+
+  QArchive::DiskExtractor x(archivePath, outputDir);
+  QSignalSpy infoSpy(&x, SIGNAL(info(QJsonObject)));
+  x.getInfo();
+  QVERIFY(infoSpy.wait(600000) || infoSpy.count());
+  QCOMPARE(infoSpy.takeFirst().at(0).toJsonObject().size(), entries);
+
+  const QString last = QString("Entry%1.txt").arg(entries - 1);
+  QSignalSpy extractorSpy(&x, SIGNAL(finished()));
+  x.extractEntry(last);
+  QVERIFY(extractorSpy.wait(600000) || extractorSpy.count());
+  QFile output(outputDir + "/" + last);
+  QVERIFY((output.open(QIODevice::ReadOnly)) == true);
+  QCOMPARE(output.readAll(), QByteArray::number(entries - 1));
+  QDir(outputDir).removeRecursively();
+  QFile::remove(archivePath);
+}
+
+void QArchiveDiskCompressorTests::compressingZip64Entries() {
+  QARCHIVE_SKIP_UNLESS_LARGE_TESTS();
+
+  /* Level 0 stores the entries, so the sparse file keeps sizes that need
+   * ZIP64 fields and the file after it gets an offset that does. */
+  const qint64 largeSize = Q_INT64_C(0x100000000) + 1024 * 1024;
+  const QString largePath = TestOutputDir + "1-Large.bin";
+  const QString afterPath = TestOutputDir + "2-After.txt";
+  const QString archivePath = TestOutputDir + "Zip64.zip";
+  const QString outputDir = TestOutputDir + "Zip64Output";
+  QFile large(largePath);
+  QVERIFY((large.open(QIODevice::WriteOnly)) == true);
+  QVERIFY(large.resize(largeSize));
+  large.close();
+  QVERIFY(writeTextInput(afterPath, 1024));
+  QFile::remove(archivePath);
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskCompressor e(archivePath, QArchive::ZipFormat);
+  e.setThreads(2);
+  e.setCompressionLevel(0);
+  e.addFiles(QStringList({"1-Large.bin", "2-After.txt"}),
+             QStringList({largePath, afterPath}));
+  QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                   &QArchiveDiskCompressorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+  QVERIFY(spyInfo.wait(3600000) || spyInfo.count());
+  QVERIFY(QFileInfo(archivePath).size() > largeSize);
+
+  /* The central directory starts past 4 GiB too. */
+  const QByteArray end = readZipEnd(archivePath);
+  QCOMPARE(readLE(end, 0, 4), quint64(0x06064B50));
+  QVERIFY(readLE(end, 48, 8) > Q_UINT64_C(0xFFFFFFFF));
+  QCOMPARE(readLE(end, 76 + 16, 4), quint64(0xFFFFFFFF));
+
+  QArchive::DiskExtractor x(archivePath, outputDir);
+  QSignalSpy infoSpy(&x, SIGNAL(info(QJsonObject)));
+  x.getInfo();
+  QVERIFY(infoSpy.wait(600000) || infoSpy.count());
+  const QJsonObject info = infoSpy.takeFirst().at(0).toJsonObject();
+  QCOMPARE(info.value("1-Large.bin").toObject().value("RawSize").toDouble(),
+           double(largeSize));
+  QCOMPARE(info.value("2-After.txt").toObject().value("RawSize").toDouble(),
+           1024.0);
+
+  QSignalSpy extractorSpy(&x, SIGNAL(finished()));
+  x.extractEntry("2-After.txt");
+  QVERIFY(extractorSpy.wait(600000) || extractorSpy.count());
+  QFile input(afterPath);
+  QVERIFY((input.open(QIODevice::ReadOnly)) == true);
+  QFile output(outputDir + "/2-After.txt");
+  QVERIFY((output.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(output.readAll() == input.readAll());
+  QDir(outputDir).removeRecursively();
+  QFile::remove(archivePath);
+  QFile::remove(largePath);
+}
+
+void QArchiveDiskCompressorTests::benchmarkCompressionLevels_data() {
+  QTest::addColumn<short>("format");
+  QTest::addColumn<int>("level");
+  for (int level : {1, 6, 9}) {
+    QTest::newRow(qPrintable(QString("zip, level %1").arg(level)))
+        << short(QArchive::ZipFormat) << level;
+    QTest::newRow(qPrintable(QString("gzip, level %1").arg(level)))
+        << short(QArchive::GZipFormat) << level;
+    QTest::newRow(qPrintable(QString("xz, level %1").arg(level)))
+        << short(QArchive::XzFormat) << level;
+  }
+  for (int level : {1, 3, 19}) {
+    QTest::newRow(qPrintable(QString("zstd, level %1").arg(level)))
+        << short(QArchive::ZstdFormat) << level;
+  }
+}
+
+void QArchiveDiskCompressorTests::benchmarkCompressionLevels() {
+  QARCHIVE_SKIP_UNLESS_BENCHMARKING();
+  QFETCH(short, format);
+  QFETCH(int, level);
+
+  const qint64 inputSize = 16 * 1024 * 1024;
+  const QString inputPath = TestOutputDir + "LevelInput.txt";
+  const QString archivePath = TestOutputDir + "Levels.archive";
+  QVERIFY(writeTextInput(inputPath, inputSize));
+
+  QBENCHMARK {
+    QFile::remove(archivePath);
+    QArchive::DiskCompressor e(archivePath, format);
+    e.setCompressionLevel(level);
+    e.addFiles(QFileInfo(inputPath).fileName(), inputPath);
+    QObject::connect(&e, &QArchive::DiskCompressor::error, this,
+                     &QArchiveDiskCompressorTests::defaultErrorHandler);
+    QSignalSpy spyInfo(&e, SIGNAL(finished()));
+    e.start();
+
+    QVERIFY(spyInfo.wait(600000) || spyInfo.count());
+  }
+  QVERIFY(QFileInfo::exists(archivePath));
+
+  /* QBENCHMARK reports the time, the ratio is what the level buys. */
+  const qint64 archiveSize = QFileInfo(archivePath).size();
+  qInfo("%lld bytes to %lld bytes, ratio %.2f", inputSize, archiveSize,
+        inputSize / qMax(1.0, double(archiveSize)));
+  QFile::remove(archivePath);
+}
+
 void QArchiveDiskCompressorTests::defaultErrorHandler(short code,
                                                       const QString& file) {
   auto scode = QString::number(code);
@@ -30,6 +30,19 @@ class QArchiveDiskCompressorTests : public QObject, private QArchiveTestCases {
   void compressEmptyFiles();
   void compressingSpecialCharacterFiles();
   void compressMultiLevelSpecialCharacterFiles();
+  void compressingWithThreads_data();
+  void compressingWithThreads();
+  void benchmarkThreadedCompression_data();
+  void benchmarkThreadedCompression();
+  void compressingWithCompressionLevel();
+  void compressingDirectoryTree();
+  void compressingDirectoryTreeWithLinks();
+  void compressingZipWithThreads();
+  void compressingStoredZipWithThreads();
+  void compressingZipWithManyEntries();
+  void compressingZip64Entries();
+  void benchmarkCompressionLevels_data();
+  void benchmarkCompressionLevels();
 
  protected slots:
   static void defaultErrorHandler(short code, const QString& file);
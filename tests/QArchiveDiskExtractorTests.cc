@@ -1,5 +1,177 @@
 #include <QArchiveDiskExtractorTests.hpp>
 
+#include <QElapsedTimer>
+
+namespace {
+void appendLE(QByteArray* out, quint32 value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out->append(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+quint32 crc32(const QByteArray& data) {
+  quint32 crc = 0xFFFFFFFF;
+  for (char c : data) {
+    crc ^= static_cast<uchar>(c);
+    for (int i = 0; i < 8; ++i) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+/* A BGZF member holding the data in a stored deflate block. */
+QByteArray bgzfMember(const QByteArray& data) {
+  QByteArray deflate(1, '\x01');
+  appendLE(&deflate, data.size(), 2);
+  appendLE(&deflate, ~data.size() & 0xFFFF, 2);
+  deflate.append(data);
+
+  QByteArray member("\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00"
+                    "BC\x02\x00",
+                    16);
+  appendLE(&member, 16 + 2 + deflate.size() + 8 - 1, 2);
+  member.append(deflate);
+  appendLE(&member, crc32(data), 4);
+  appendLE(&member, data.size(), 4);
+  return member;
+}
+
+/* A plain gzip member, without the size field of BGZF, holding the data in
+ * stored deflate blocks. */
+QByteArray gzipMember(const QByteArray& data) {
+  QByteArray member("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff", 10);
+  int pos = 0;
+  do {
+    const int size = qMin(data.size() - pos, 65535);
+    const bool last = pos + size == data.size();
+    member.append(last ? '\x01' : '\x00');
+    appendLE(&member, size, 2);
+    appendLE(&member, ~size & 0xFFFF, 2);
+    member.append(data.mid(pos, size));
+    pos += size;
+  } while (pos < data.size());
+  appendLE(&member, crc32(data), 4);
+  appendLE(&member, data.size(), 4);
+  return member;
+}
+
+/* A zstd frame with a 128 KiB window holding the data in raw blocks. */
+QByteArray zstdFrame(const QByteArray& data) {
+  QByteArray frame("\x28\xb5\x2f\xfd\x00\x38", 6);
+  int pos = 0;
+  do {
+    const int size = qMin(data.size() - pos, 128 * 1024);
+    const bool last = pos + size == data.size();
+    appendLE(&frame, (size << 3) | (last ? 1 : 0), 3);
+    frame.append(data.mid(pos, size));
+    pos += size;
+  } while (pos < data.size());
+  return frame;
+}
+
+/* A ustar entry holding the data under the given name, which can be any
+ * bytes up to 100 of them. Names ending with a '/' are directories. */
+QByteArray tarEntry(const QByteArray& name, const QByteArray& data) {
+  QByteArray header(512, '\0');
+  auto setOctal = [&](int offset, int width, qint64 value) {
+    header.replace(offset, width - 1,
+                   QByteArray::number(value, 8).rightJustified(width - 1, '0'));
+  };
+  const bool directory = name.endsWith('/');
+  header.replace(0, name.size(), name);
+  setOctal(100, 8, directory ? 0755 : 0644);
+  setOctal(108, 8, 0);
+  setOctal(116, 8, 0);
+  setOctal(124, 12, data.size());
+  setOctal(136, 12, 1600000000);
+  header[156] = directory ? '5' : '0';
+  header.replace(257, 8, QByteArray("ustar\0" "00", 8));
+
+  // The checksum is taken with its own field filled with spaces.
+  header.replace(148, 8, QByteArray(8, ' '));
+  int checksum = 0;
+  for (char c : header) {
+    checksum += static_cast<uchar>(c);
+  }
+  header.replace(148, 8,
+                 QByteArray::number(checksum, 8).rightJustified(6, '0') +
+                     QByteArray("\0 ", 2));
+
+  QByteArray entry = header + data;
+  entry.append(QByteArray((512 - entry.size() % 512) % 512, '\0'));
+  return entry;
+}
+
+/* Writes a tar archive of the given entries. */
+bool writeTar(const QString& path, const QByteArray& entries) {
+  QFile archive(path);
+  return archive.open(QIODevice::WriteOnly) &&
+         archive.write(entries + QByteArray(1024, '\0')) ==
+             entries.size() + 1024;
+}
+
+/* The files below the directory, relative to it. */
+QStringList listFiles(const QString& dir) {
+  QStringList files;
+  QDirIterator it(dir, QDir::Files | QDir::Hidden,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    files << QDir(dir).relativeFilePath(it.next());
+  }
+  files.sort();
+  return files;
+}
+
+/* Text-like data of the given size, different for every seed. */
+QByteArray makeText(quint32 seed, int size) {
+  const char* words[] = {"archive ", "block ",  "core ",  "data ",
+                         "entry ",   "filter ", "group ", "header "};
+  QByteArray text;
+  while (text.size() < size) {
+    seed = seed * 1103515245 + 12345;
+    text.append(words[(seed >> 16) % 8]);
+  }
+  text.truncate(size);
+  return text;
+}
+
+/* Writes a ZIP archive of entries of very different sizes with the files
+ * it is made of in the given directory, giving their contents by name or
+ * nothing if it failed. */
+QMap<QString, QByteArray> writeZipArchive(const QString& archivePath,
+                                          const QString& inputDir) {
+  const int sizes[] = {3 << 20, 0, 1 << 20, 100, 2 << 20, 512 << 10};
+  QMap<QString, QByteArray> files;
+  QStringList names;
+  QStringList paths;
+  if (!QDir().mkpath(inputDir)) {
+    return {};
+  }
+  for (int i = 0; i < 6; ++i) {
+    const QString name = QString("Entry%1.txt").arg(i);
+    files[name] = makeText(i + 1, sizes[i]);
+    QFile input(inputDir + "/" + name);
+    if (!input.open(QIODevice::WriteOnly) ||
+        input.write(files[name]) != files[name].size()) {
+      return {};
+    }
+    names << name;
+    paths << input.fileName();
+  }
+
+  QFile::remove(archivePath);
+  QArchive::DiskCompressor c(archivePath, QArchive::ZipFormat);
+  c.addFiles(names, paths);
+  QSignalSpy spyInfo(&c, SIGNAL(finished()));
+  c.start();
+  if (!spyInfo.wait(60000) && !spyInfo.count()) {
+    return {};
+  }
+  return files;
+}
+}  // namespace
+
 void QArchiveDiskExtractorTests::initTestCase() {
   QDir cases(TestCasesDir);
   if (cases.exists()) {
@@ -308,6 +480,806 @@ void QArchiveDiskExtractorTests::testProgress() {
   QCOMPARE(progressSpyInfo.count(), 4);
 }
 
+void QArchiveDiskExtractorTests::testInputProgress() {
+  QArchive::DiskExtractor e(TestCase5ArchivePath, TestCase5OutputDir);
+  e.setCalculateProgress(true);
+  e.setProgressMode(QArchive::InputProgress);
+
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy finishedSpyInfo(&e, SIGNAL(finished()));
+  QSignalSpy progressSpyInfo(
+      &e, SIGNAL(progress(QString, int, int, qint64, qint64)));
+
+  e.start();
+
+  QVERIFY(finishedSpyInfo.wait() || finishedSpyInfo.count());
+  QVERIFY(progressSpyInfo.count() > 0);
+
+  /* No entries are counted since getInfo was not called. */
+  auto last = progressSpyInfo.takeLast();
+  QCOMPARE(last.at(2).toInt(), -1);
+  QCOMPARE(last.at(4).toLongLong(), QFileInfo(TestCase5ArchivePath).size());
+  QVERIFY(last.at(3).toLongLong() <= last.at(4).toLongLong());
+}
+
+void QArchiveDiskExtractorTests::testThrottledProgress() {
+  QArchive::DiskExtractor e(TestCase3ArchivePath, TestCase3OutputDir);
+  e.setCalculateProgress(true);
+  e.setBlockSize(4);
+  e.setProgressInterval(60 * 1000);
+
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy finishedSpyInfo(&e, SIGNAL(finished()));
+  QSignalSpy progressSpyInfo(
+      &e, SIGNAL(progress(QString, int, int, qint64, qint64)));
+
+  e.start();
+
+  QVERIFY(finishedSpyInfo.wait() || finishedSpyInfo.count());
+
+  /* The first progress gets through, and the final one always does. How
+   * many more pass depends on the timing. */
+  QVERIFY(progressSpyInfo.count() >= 2);
+  auto last = progressSpyInfo.takeLast();
+  QCOMPARE(last.at(1).toInt(), last.at(2).toInt());
+  QCOMPARE(last.at(3).toLongLong(), last.at(4).toLongLong());
+}
+
+void QArchiveDiskExtractorTests::usingIndexCache() {
+  const QString cacheDir = TestOutputDir + "IndexCache";
+  QJsonObject scanned;
+  {
+    QArchive::DiskExtractor e(TestCase3ArchivePath);
+    e.setIndexCacheDirectory(cacheDir);
+    QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                     &QArchiveDiskExtractorTests::defaultErrorHandler);
+
+    QSignalSpy statisticsSpy(&e, &QArchive::DiskExtractor::statistics);
+    QSignalSpy spyInfo(&e, SIGNAL(info(QJsonObject)));
+    e.getInfo();
+    QVERIFY(spyInfo.wait() || spyInfo.count());
+    scanned = spyInfo.takeFirst().at(0).toJsonObject();
+    QVERIFY(statisticsSpy.count() || statisticsSpy.wait());
+    QVERIFY(statisticsSpy.takeFirst()
+                .at(0)
+                .toJsonObject()
+                .value("Reads")
+                .toInt() > 0);
+  }
+
+  /* The index must be written to the cache directory. */
+  QCOMPARE(QDir(cacheDir).entryList(QDir::Files).size(), 1);
+
+  QArchive::DiskExtractor e(TestCase3ArchivePath);
+  e.setIndexCacheDirectory(cacheDir);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+
+  /* The same information comes from the index without reading the
+   * archive. */
+  QSignalSpy statisticsSpy(&e, &QArchive::DiskExtractor::statistics);
+  QSignalSpy spyInfo(&e, SIGNAL(info(QJsonObject)));
+  e.getInfo();
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+  QCOMPARE(spyInfo.takeFirst().at(0).toJsonObject(), scanned);
+  QVERIFY(statisticsSpy.count() || statisticsSpy.wait());
+  const auto statistics = statisticsSpy.takeFirst().at(0).toJsonObject();
+  QCOMPARE(statistics.value("Reads").toInt(), 0);
+  QCOMPARE(statistics.value("BytesRead").toInt(), 0);
+}
+
+void QArchiveDiskExtractorTests::extractingEntriesFromIndex() {
+  /* The large entry comes first and is not asked for. */
+  const int largeSize = 16 * 1024 * 1024;
+  const QString archivePath = TestOutputDir + "Indexed.tar";
+  QVERIFY(writeTar(archivePath,
+                   tarEntry("Large.bin", QByteArray(largeSize, 'x')) +
+                       tarEntry("Small.txt", "TESTINDEXSUCCESS!")));
+  const QString cacheDir = TestOutputDir + "IndexedCache";
+  {
+    QArchive::DiskExtractor e(archivePath);
+    e.setIndexCacheDirectory(cacheDir);
+    QSignalSpy spyInfo(&e, SIGNAL(info(QJsonObject)));
+    e.getInfo();
+    QVERIFY(spyInfo.wait() || spyInfo.count());
+  }
+
+  const QString outputDir = TestOutputDir + "Indexed";
+  QVERIFY(QDir().mkpath(outputDir));
+  QArchive::DiskExtractor e(archivePath, outputDir);
+  e.setIndexCacheDirectory(cacheDir);
+  e.setDropPageCache(true);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy statisticsSpy(&e, &QArchive::DiskExtractor::statistics);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.extractEntries(QStringList() << "Small.txt");
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+  QVERIFY(!QFileInfo::exists(outputDir + "/Large.bin"));
+  QFile TestOutput(outputDir + "/Small.txt");
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QCOMPARE(TestOutput.readAll(), QByteArray("TESTINDEXSUCCESS!"));
+
+  /* Reading starts at the header of the entry, the large one is neither
+   * read nor skipped. */
+  QCOMPARE(statisticsSpy.count(), 1);
+  auto statistics = statisticsSpy.takeFirst().at(0).toJsonObject();
+  QCOMPARE(statistics.value("Skips").toInt(), 0);
+  QVERIFY(statistics.value("BytesRead").toDouble() < largeSize / 2);
+  QFile::remove(archivePath);
+}
+
+void QArchiveDiskExtractorTests::parallelExtraction() {
+  const QString outputDir = TestOutputDir + "Parallel";
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskExtractor e(TestCase3ArchivePath, outputDir);
+  e.setThreads(2);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  /* 7-Zip archives are extracted by a single thread, both entries must be
+   * extracted anyway. */
+  QFile TestOutput(outputDir + "/" + QFileInfo(Test3OutputFile1).fileName());
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(Test3Output1Contents == QString(TestOutput.readAll()));
+  TestOutput.close();
+
+  TestOutput.setFileName(outputDir + "/" +
+                         QFileInfo(Test3OutputFile2).fileName());
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(Test3Output2Contents == QString(TestOutput.readAll()));
+}
+
+void QArchiveDiskExtractorTests::parallelZipExtraction() {
+  const QString archivePath = TestOutputDir + "ParallelZip.zip";
+  const auto files =
+      writeZipArchive(archivePath, TestOutputDir + "ParallelZip");
+  QVERIFY(!files.isEmpty());
+
+  const QString outputDir = TestOutputDir + "ParallelZipOutput";
+  QVERIFY(QDir().mkpath(outputDir));
+  QArchive::DiskExtractor e(archivePath, outputDir);
+  e.setThreads(3);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  /* Every entry must be extracted whichever thread it was given to. */
+  for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+    QFile TestOutput(outputDir + "/" + it.key());
+    QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+    QVERIFY(it.value() == TestOutput.readAll());
+  }
+}
+
+void QArchiveDiskExtractorTests::pausingParallelExtraction() {
+  const QString archivePath = TestOutputDir + "ParallelZip.zip";
+  const auto files =
+      writeZipArchive(archivePath, TestOutputDir + "ParallelZip");
+  QVERIFY(!files.isEmpty());
+
+  const QString outputDir = TestOutputDir + "ParallelZipPaused";
+  QVERIFY(QDir().mkpath(outputDir));
+  QArchive::DiskExtractor e(archivePath, outputDir);
+  e.setThreads(3);
+  bool pausedEmitted = false;
+  bool resumedEmitted = false;
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QObject::connect(&e, &QArchive::DiskExtractor::started,
+                   [&]() { e.pause(); });
+  QObject::connect(&e, &QArchive::DiskExtractor::paused, [&]() {
+    pausedEmitted = true;
+    e.resume();
+  });
+  QObject::connect(&e, &QArchive::DiskExtractor::resumed,
+                   [&]() { resumedEmitted = true; });
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  /* The pause stops the threads, the rest is extracted on resume. */
+  QVERIFY(pausedEmitted);
+  QVERIFY(resumedEmitted);
+  for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+    QFile TestOutput(outputDir + "/" + it.key());
+    QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+    QVERIFY(it.value() == TestOutput.readAll());
+  }
+}
+
+void QArchiveDiskExtractorTests::rewritingEntryPaths_data() {
+  QTest::addColumn<QByteArray>("entry");
+  QTest::addColumn<QString>("basePath");
+  QTest::addColumn<QStringList>("files");
+  const QByteArray nonASCII("Дирек/файл.txt");
+  QTest::newRow("ASCII") << QByteArray("a/b.txt") << QString()
+                         << QStringList({"a/b.txt"});
+  QTest::newRow("non-ASCII") << nonASCII << QString()
+                             << QStringList({QString::fromUtf8(nonASCII)});
+  QTest::newRow("non-ASCII base path")
+      << nonASCII << QString::fromUtf8("Дирек")
+      << QStringList({QString::fromUtf8("файл.txt")});
+  QTest::newRow("dot components") << QByteArray("./a/./b.txt") << "a"
+                                  << QStringList({"b.txt"});
+  QTest::newRow("empty components") << QByteArray("a//b.txt") << "a"
+                                    << QStringList({"b.txt"});
+  QTest::newRow("dot-dot component") << QByteArray("a/b/../c.txt") << "a"
+                                     << QStringList({"c.txt"});
+  QTest::newRow("absolute entry") << QByteArray("/a/b.txt") << "a"
+                                  << QStringList({"b.txt"});
+  QTest::newRow("base path with slashes") << QByteArray("a/b/c.txt")
+                                          << "/a/b/" << QStringList({"c.txt"});
+  QTest::newRow("root of the base path") << QByteArray("a/") << "a"
+                                         << QStringList();
+}
+
+void QArchiveDiskExtractorTests::rewritingEntryPaths() {
+  QFETCH(QByteArray, entry);
+  QFETCH(QString, basePath);
+  QFETCH(QStringList, files);
+
+  const QString archivePath = TestOutputDir + "Paths.tar";
+  QVERIFY(writeTar(archivePath, tarEntry(entry, entry)));
+  const QString outputDir = TestOutputDir + "Paths";
+  QVERIFY(QDir(outputDir).removeRecursively());
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskExtractor e(archivePath, outputDir);
+  if (!basePath.isEmpty()) {
+    e.setBasePath(basePath);
+  }
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  /* Same paths as QDir::relativeFilePath() of the base path gives. */
+  QCOMPARE(listFiles(outputDir), files);
+  for (const auto& file : files) {
+    QFile output(outputDir + "/" + file);
+    QVERIFY((output.open(QIODevice::ReadOnly)) == true);
+    QCOMPARE(output.readAll(), entry);
+  }
+}
+
+void QArchiveDiskExtractorTests::extractingInvalidUTF8Path() {
+  const QString archivePath = TestOutputDir + "InvalidUTF8.tar";
+  const QByteArray data("TESTINVALIDUTF8");
+  QVERIFY(writeTar(archivePath, tarEntry("bad\xff\xfe.txt", data)));
+  const QString outputDir = TestOutputDir + "InvalidUTF8";
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskExtractor e(archivePath, outputDir);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  /* The name can't be decoded, the file must land in the output directory
+   * anyway. */
+  const auto files = QDir(outputDir).entryList(QDir::Files);
+  QCOMPARE(files.size(), 1);
+  QCOMPARE(QFileInfo(outputDir + "/" + files.first()).size(),
+           qint64(data.size()));
+}
+
+void QArchiveDiskExtractorTests::benchmarkEntryPathRewriting() {
+  QARCHIVE_SKIP_UNLESS_BENCHMARKING();
+
+  /* Many small entries so the cost per entry stands out. */
+  const QString archivePath = TestOutputDir + "ManyPaths.tar";
+  QByteArray entries;
+  for (int i = 0; i < 20000; ++i) {
+    const auto name = QString::fromUtf8("Дирек/%1/файл%2.txt")
+                          .arg(i % 100)
+                          .arg(i)
+                          .toUtf8();
+    entries += tarEntry(name, name);
+  }
+  QVERIFY(writeTar(archivePath, entries));
+  const QString outputDir = TestOutputDir + "ManyPaths";
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QBENCHMARK {
+    QArchive::DiskExtractor e(archivePath, outputDir);
+    e.setBasePath(QString::fromUtf8("Дирек"));
+    QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                     &QArchiveDiskExtractorTests::defaultErrorHandler);
+    QSignalSpy spyInfo(&e, SIGNAL(finished()));
+    e.start();
+
+    QVERIFY(spyInfo.wait(600000) || spyInfo.count());
+  }
+  QVERIFY(QDir(outputDir).removeRecursively());
+  QFile::remove(archivePath);
+}
+
+void QArchiveDiskExtractorTests::extractingSingleEntry() {
+  const QString outputDir = TestOutputDir + "SingleEntry";
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskExtractor e(TestCase3ArchivePath, outputDir);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.extractEntry(QFileInfo(Test3OutputFile2).fileName());
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  /* Only the requested entry must be extracted. */
+  QVERIFY(!QFileInfo::exists(outputDir + "/" +
+                             QFileInfo(Test3OutputFile1).fileName()));
+  QFile TestOutput(outputDir + "/" + QFileInfo(Test3OutputFile2).fileName());
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(Test3Output2Contents == QString(TestOutput.readAll()));
+
+  /* The entries are only for that extraction, a later start extracts
+   * everything again. */
+  e.start();
+
+  QVERIFY(spyInfo.wait() || spyInfo.count() == 2);
+  QVERIFY(QFileInfo::exists(outputDir + "/" +
+                            QFileInfo(Test3OutputFile1).fileName()));
+}
+
+void QArchiveDiskExtractorTests::usingDirectoryFilters() {
+  const QString outputDir = TestOutputDir + "DirectoryFilter";
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskExtractor e(TestCase10ArchivePath, outputDir);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+
+  /* A filter ending with '/' extracts everything inside the directory. */
+  e.addFilter(Test10EntryName.section('/', 0, 0) + "/");
+  e.start();
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  QFile TestOutput(outputDir + "/" + Test10EntryName);
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(Test10OutputContents == QString::fromUtf8(TestOutput.readAll()));
+
+  /* Without the '/' the filter still has to match an entry exactly. */
+  const QString exactDir = TestOutputDir + "ExactFilter";
+  QVERIFY(QDir().mkpath(exactDir));
+  QArchive::DiskExtractor x(TestCase10ArchivePath, exactDir);
+  QObject::connect(&x, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy exactSpy(&x, SIGNAL(finished()));
+  x.addFilter(Test10EntryName.section('/', 0, 0));
+  x.start();
+
+  QVERIFY(exactSpy.wait() || exactSpy.count());
+  QVERIFY(!QFileInfo::exists(exactDir + "/" + Test10EntryName));
+}
+
+void QArchiveDiskExtractorTests::cancelingWithoutEventProcessing() {
+  const QString outputDir = TestOutputDir + "Canceled";
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskExtractor e(TestCase2ArchivePath, outputDir);
+  /* The cancel request must not depend on the event loop. */
+  e.setProcessEventsInterval(60 * 1000);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QObject::connect(&e, &QArchive::DiskExtractor::started,
+                   [&]() { e.cancel(); });
+  QSignalSpy spyInfo(&e, SIGNAL(canceled()));
+  e.start();
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+}
+
+void QArchiveDiskExtractorTests::readingStatistics() {
+  QArchive::DiskExtractor e(TestCase1ArchivePath, TestCase1OutputDir);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy statisticsSpy(&e, &QArchive::DiskExtractor::statistics);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+  QCOMPARE(statisticsSpy.count(), 1);
+
+  /* Archive files get a large block size and are read in place. */
+  auto statistics = statisticsSpy.takeFirst().at(0).toJsonObject();
+  QCOMPARE(statistics.value("BlockSize").toInt(), 1024 * 1024);
+  QVERIFY(statistics.value("MemoryBacked").toBool());
+  QVERIFY(statistics.value("Reads").toInt() > 0);
+  QVERIFY(statistics.value("BytesRead").toInt() > 0);
+
+  /* Dropping the page cache reads the file instead. */
+  QArchive::DiskExtractor d(TestCase1ArchivePath, TestCase1OutputDir);
+  QObject::connect(&d, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy dropStatisticsSpy(&d, &QArchive::DiskExtractor::statistics);
+  QSignalSpy dropSpyInfo(&d, SIGNAL(finished()));
+  d.setDropPageCache(true);
+  d.setBlockSize(4096);
+  d.start();
+
+  QVERIFY(dropSpyInfo.wait() || dropSpyInfo.count());
+  QCOMPARE(dropStatisticsSpy.count(), 1);
+
+  statistics = dropStatisticsSpy.takeFirst().at(0).toJsonObject();
+  QCOMPARE(statistics.value("BlockSize").toInt(), 4096);
+  QVERIFY(!statistics.value("MemoryBacked").toBool());
+}
+
+void QArchiveDiskExtractorTests::skippingFilteredEntries_data() {
+  QTest::addColumn<bool>("dropPageCache");
+  QTest::newRow("mapped") << false;
+  QTest::newRow("read") << true;
+}
+
+void QArchiveDiskExtractorTests::skippingFilteredEntries() {
+  QFETCH(bool, dropPageCache);
+
+  /* The large entry comes first and is not extracted. */
+  const int largeSize = 16 * 1024 * 1024;
+  const QString archivePath = TestOutputDir + "Skipping.tar";
+  QVERIFY(writeTar(archivePath,
+                   tarEntry("Large.bin", QByteArray(largeSize, 'x')) +
+                       tarEntry("Small.txt", "TESTSKIPSUCCESS!")));
+  const QString outputDir = TestOutputDir + "Skipping";
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QArchive::DiskExtractor e(archivePath, outputDir);
+  e.setDropPageCache(dropPageCache);
+  e.addFilter("Small.txt");
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy statisticsSpy(&e, &QArchive::DiskExtractor::statistics);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+  QVERIFY(!QFileInfo::exists(outputDir + "/Large.bin"));
+  QFile TestOutput(outputDir + "/Small.txt");
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QCOMPARE(TestOutput.readAll(), QByteArray("TESTSKIPSUCCESS!"));
+
+  /* Most of the large entry is skipped instead of read. */
+  QCOMPARE(statisticsSpy.count(), 1);
+  auto statistics = statisticsSpy.takeFirst().at(0).toJsonObject();
+  QVERIFY(statistics.value("Skips").toInt() > 0);
+  QVERIFY(statistics.value("BytesSkipped").toDouble() > largeSize / 2);
+  QVERIFY(statistics.value("BytesRead").toDouble() < largeSize / 2);
+  QFile::remove(archivePath);
+}
+
+void QArchiveDiskExtractorTests::benchmarkSkippingEntries() {
+  QARCHIVE_SKIP_UNLESS_BENCHMARKING();
+
+  /* Extracting the last entry costs a skip per large entry. */
+  const QString archivePath = TestOutputDir + "SkippingMany.tar";
+  QByteArray entries;
+  for (int i = 0; i < 8; ++i) {
+    entries += tarEntry(QString("Large%1.bin").arg(i).toUtf8(),
+                        QByteArray(32 * 1024 * 1024, 'x'));
+  }
+  QVERIFY(writeTar(archivePath, entries + tarEntry("Small.txt", "SMALL")));
+  entries.clear();
+  const QString outputDir = TestOutputDir + "SkippingMany";
+  QVERIFY(QDir().mkpath(outputDir));
+
+  QBENCHMARK {
+    QArchive::DiskExtractor e(archivePath, outputDir);
+    e.setDropPageCache(true);
+    e.addFilter("Small.txt");
+    QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                     &QArchiveDiskExtractorTests::defaultErrorHandler);
+    QSignalSpy spyInfo(&e, SIGNAL(finished()));
+    e.start();
+
+    QVERIFY(spyInfo.wait(600000) || spyInfo.count());
+  }
+  QFile::remove(archivePath);
+}
+
+void QArchiveDiskExtractorTests::extractingWithReadAhead() {
+  QDir(TestCase1OutputDir).removeRecursively();
+  QArchive::DiskExtractor e(TestCase1ArchivePath, TestCase1OutputDir);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+
+  /* Small blocks so 7-Zip seeks over blocks which were read ahead. */
+  e.setBlockSize(1024);
+  e.setReadAhead(4);
+  QSignalSpy statisticsSpy(&e, &QArchive::DiskExtractor::statistics);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+  QCOMPARE(statisticsSpy.count(), 1);
+  QVERIFY(!statisticsSpy.takeFirst()
+               .at(0)
+               .toJsonObject()
+               .value("MemoryBacked")
+               .toBool());
+
+  QFile TestOutput(Test1OutputFile);
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(Test1OutputContents == QString(TestOutput.readAll()));
+}
+
+void QArchiveDiskExtractorTests::extractingGrowingArchive() {
+  QFile source(TestCase6ArchivePath);
+  QVERIFY(source.open(QIODevice::ReadOnly) == true);
+  const QByteArray contents = source.readAll();
+
+  /* Only the first half of the archive is written when it starts. */
+  const QString growingArchivePath = TestOutputDir + "Growing.tar";
+  QFile growing(growingArchivePath);
+  QVERIFY(growing.open(QIODevice::WriteOnly | QIODevice::Truncate) == true);
+  growing.write(contents.left(contents.size() / 2));
+  growing.flush();
+
+  QDir(TestCase6OutputDir).removeRecursively();
+  QArchive::DiskExtractor e(growingArchivePath, TestCase6OutputDir,
+                            /*parent=*/nullptr, /*singleThreaded=*/false);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  e.setFollowTimeout(2000);
+
+  QTimer::singleShot(300, [&]() {
+    growing.write(contents.mid(contents.size() / 2));
+    growing.close();
+  });
+
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  QVERIFY(spyInfo.wait(10000) || spyInfo.count() == 1);
+  QFile TestOutput(Test6OutputFile);
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(Test6OutputContents == QString(TestOutput.readAll()));
+}
+
+void QArchiveDiskExtractorTests::pausingGrowingArchive() {
+  const QByteArray first = makeText(1, 64 * 1024);
+  const QByteArray second = makeText(2, 64 * 1024);
+  const QByteArray contents = tarEntry("First.txt", first) +
+                              tarEntry("Second.txt", second) +
+                              QByteArray(1024, '\0');
+
+  /* The writer stalls in the middle of the second entry. */
+  const QString growingArchivePath = TestOutputDir + "PausedGrowing.tar";
+  const int stall = static_cast<int>(contents.size() - second.size() / 2);
+  QFile growing(growingArchivePath);
+  QVERIFY(growing.open(QIODevice::WriteOnly | QIODevice::Truncate) == true);
+  growing.write(contents.left(stall));
+  growing.flush();
+
+  const QString outputDir = TestOutputDir + "PausedGrowing";
+  QDir(outputDir).removeRecursively();
+  QVERIFY(QDir().mkpath(outputDir));
+  QArchive::DiskExtractor e(growingArchivePath, outputDir,
+                            /*parent=*/nullptr, /*singleThreaded=*/false);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  e.setFollowTimeout(30000);
+
+  QSignalSpy spyStarted(&e, SIGNAL(started()));
+  QSignalSpy spyPaused(&e, SIGNAL(paused()));
+  QSignalSpy spyFinished(&e, SIGNAL(finished()));
+  e.start();
+  QVERIFY(spyStarted.wait() || spyStarted.count());
+
+  /* The pause stops the wait for the writer instead of the timeout. */
+  QTest::qWait(300);
+  QElapsedTimer timer;
+  timer.start();
+  e.pause();
+  QVERIFY(spyPaused.wait(10000) || spyPaused.count());
+  QVERIFY(timer.elapsed() < 10000);
+
+  growing.write(contents.mid(stall));
+  growing.close();
+  e.resume();
+  QVERIFY(spyFinished.wait(60000) || spyFinished.count());
+
+  QFile firstOutput(outputDir + "/First.txt");
+  QVERIFY(firstOutput.open(QIODevice::ReadOnly) == true);
+  QCOMPARE(firstOutput.readAll(), first);
+  QFile secondOutput(outputDir + "/Second.txt");
+  QVERIFY(secondOutput.open(QIODevice::ReadOnly) == true);
+  QCOMPARE(secondOutput.readAll(), second);
+}
+
+void QArchiveDiskExtractorTests::cancelingGrowingArchive() {
+  QFile source(TestCase6ArchivePath);
+  QVERIFY(source.open(QIODevice::ReadOnly) == true);
+
+  /* Only the header of the entry is written and the writer never comes
+   * back. */
+  const QString growingArchivePath = TestOutputDir + "CanceledGrowing.tar";
+  QFile growing(growingArchivePath);
+  QVERIFY(growing.open(QIODevice::WriteOnly | QIODevice::Truncate) == true);
+  growing.write(source.read(512));
+  growing.close();
+
+  QDir(TestCase6OutputDir).removeRecursively();
+  QArchive::DiskExtractor e(growingArchivePath, TestCase6OutputDir,
+                            /*parent=*/nullptr, /*singleThreaded=*/false);
+  e.setFollowTimeout(30000);
+
+  QSignalSpy spyStarted(&e, SIGNAL(started()));
+  QSignalSpy spyCanceled(&e, SIGNAL(canceled()));
+  e.start();
+  QVERIFY(spyStarted.wait() || spyStarted.count());
+
+  QTest::qWait(300);
+  QElapsedTimer timer;
+  timer.start();
+  e.cancel();
+  QVERIFY(spyCanceled.wait(10000) || spyCanceled.count());
+  QVERIFY(timer.elapsed() < 10000);
+}
+
+void QArchiveDiskExtractorTests::followingCompleteArchiveOnce() {
+  QDir(TestCase6OutputDir).removeRecursively();
+  QArchive::DiskExtractor e(TestCase6ArchivePath, TestCase6OutputDir);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  e.setFollowTimeout(3000);
+
+  /* Listing the archive waits once at its end, after that it is known to
+   * be complete. */
+  QSignalSpy spyInfo(&e, SIGNAL(info(QJsonObject)));
+  e.getInfo();
+  QVERIFY(spyInfo.wait(10000) || spyInfo.count());
+
+  QElapsedTimer timer;
+  timer.start();
+  QSignalSpy spyFinished(&e, SIGNAL(finished()));
+  e.start();
+  QVERIFY(spyFinished.wait(10000) || spyFinished.count());
+  QVERIFY(timer.elapsed() < 3000);
+
+  QFile TestOutput(Test6OutputFile);
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(Test6OutputContents == QString(TestOutput.readAll()));
+}
+
+void QArchiveDiskExtractorTests::extractingWithBlockCache() {
+  QDir(TestCase1OutputDir).removeRecursively();
+  QArchive::DiskExtractor e(TestCase1ArchivePath, TestCase1OutputDir);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+
+  /* 7-Zip seeks back to the start after reading the header at the end. */
+  e.setBlockSize(1024);
+  e.setBlockCache(8);
+  QSignalSpy statisticsSpy(&e, &QArchive::DiskExtractor::statistics);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+  QCOMPARE(statisticsSpy.count(), 1);
+
+  auto statistics = statisticsSpy.takeFirst().at(0).toJsonObject();
+  QVERIFY(!statistics.value("MemoryBacked").toBool());
+  QVERIFY(statistics.value("CacheMisses").toInt() > 0);
+  QVERIFY(statistics.value("CacheHits").toInt() > 0);
+
+  QFile TestOutput(Test1OutputFile);
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(Test1OutputContents == QString(TestOutput.readAll()));
+}
+
+void QArchiveDiskExtractorTests::extractingWithFormatHint() {
+  QDir(TestCase1OutputDir).removeRecursively();
+  QArchive::DiskExtractor e(TestCase1ArchivePath, TestCase1OutputDir);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  e.setArchiveFormat(QArchive::AutoFormat);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  QFile TestOutput(Test1OutputFile);
+  QVERIFY((TestOutput.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(Test1OutputContents == QString(TestOutput.readAll()));
+  TestOutput.close();
+
+  /* Only the ZIP reader is enabled, so the 7-Zip archive cannot be read. */
+  QArchive::DiskExtractor z(TestCase1ArchivePath, TestCase1OutputDir);
+  z.setArchiveFormat(QArchive::ZipFormat);
+  QSignalSpy errorSpy(&z, SIGNAL(error(short)));
+  z.start();
+
+  QVERIFY(errorSpy.wait() || errorSpy.count());
+}
+
+void QArchiveDiskExtractorTests::extractingWithParallelDecompression_data() {
+  QTest::addColumn<QString>("suffix");
+  QTest::addColumn<bool>("plainTail");
+  QTest::newRow("bgzf") << "gz" << false;
+  QTest::newRow("bgzf, then plain gzip") << "gz" << true;
+  QTest::newRow("zstd") << "zst" << false;
+}
+
+void QArchiveDiskExtractorTests::extractingWithParallelDecompression() {
+  QFETCH(QString, suffix);
+  QFETCH(bool, plainTail);
+
+  const QByteArray contents = makeText(3, 3 * 1024 * 1024);
+  const QByteArray data =
+      tarEntry("Parallel.txt", contents) + QByteArray(1024, '\0');
+
+  /* A stored deflate block holds less than 64 KiB, so the archive is split
+   * over a lot of members or frames. They add up to more than the 1 MiB
+   * chunks the threads decompress. The last third may be a plain gzip
+   * member, which has to be decompressed as a single stream. */
+  const int part = 60000;
+  const int end = plainTail ? data.size() / 3 * 2 : data.size();
+  QByteArray compressed;
+  for (int pos = 0; pos < end; pos += part) {
+    const QByteArray piece = data.mid(pos, qMin(part, end - pos));
+    compressed += suffix == "gz" ? bgzfMember(piece) : zstdFrame(piece);
+  }
+  if (plainTail) {
+    compressed += gzipMember(data.mid(end));
+  } else if (suffix == "gz") {
+    compressed += bgzfMember(QByteArray());
+  }
+
+  const QString archivePath = TestOutputDir + "Parallel.tar." + suffix;
+  QFile archive(archivePath);
+  QVERIFY(archive.open(QIODevice::WriteOnly));
+  QCOMPARE(archive.write(compressed), qint64(compressed.size()));
+  archive.close();
+
+  const QString outputDir = TestOutputDir + "Parallel";
+  QDir(outputDir).removeRecursively();
+  QVERIFY(QDir().mkpath(outputDir));
+  QArchive::DiskExtractor e(archivePath, outputDir);
+  e.setThreads(2);
+  QObject::connect(&e, &QArchive::DiskExtractor::error, this,
+                   &QArchiveDiskExtractorTests::defaultErrorHandler);
+  QSignalSpy statisticsSpy(&e, &QArchive::DiskExtractor::statistics);
+  QSignalSpy spyInfo(&e, SIGNAL(finished()));
+  e.start();
+
+  QVERIFY(spyInfo.wait(60000) || spyInfo.count());
+  QCOMPARE(statisticsSpy.count(), 1);
+  QCOMPARE(statisticsSpy.takeFirst()
+               .at(0)
+               .toJsonObject()
+               .value("DecompressionThreads")
+               .toInt(),
+           2);
+
+  QFile output(outputDir + "/Parallel.txt");
+  QVERIFY((output.open(QIODevice::ReadOnly)) == true);
+  QVERIFY(output.readAll() == contents);
+}
+
 void QArchiveDiskExtractorTests::defaultErrorHandler(short code) {
   auto scode = QString::number(code);
   scode.prepend("error:: ");
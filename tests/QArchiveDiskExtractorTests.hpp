@@ -6,7 +6,9 @@
 #include <QArchive/QArchive>
 #endif
 #include <QArchiveTestCases.hpp>
+#include <QDirIterator>
 #include <QJsonObject>
+#include <QMap>
 #include <QSignalSpy>
 #include <QTemporaryDir>
 #include <QTest>
@@ -33,6 +35,33 @@ class QArchiveDiskExtractorTests : public QObject, private QArchiveTestCases {
   void extractMultiLevelSpecialCharacterFiles();
   void isExtractorObjectReuseable();
   void testProgress();
+  void testInputProgress();
+  void testThrottledProgress();
+  void usingIndexCache();
+  void extractingEntriesFromIndex();
+  void parallelExtraction();
+  void parallelZipExtraction();
+  void pausingParallelExtraction();
+  void rewritingEntryPaths_data();
+  void rewritingEntryPaths();
+  void extractingInvalidUTF8Path();
+  void benchmarkEntryPathRewriting();
+  void extractingSingleEntry();
+  void usingDirectoryFilters();
+  void cancelingWithoutEventProcessing();
+  void readingStatistics();
+  void skippingFilteredEntries_data();
+  void skippingFilteredEntries();
+  void benchmarkSkippingEntries();
+  void extractingWithReadAhead();
+  void extractingGrowingArchive();
+  void pausingGrowingArchive();
+  void cancelingGrowingArchive();
+  void followingCompleteArchiveOnce();
+  void extractingWithBlockCache();
+  void extractingWithFormatHint();
+  void extractingWithParallelDecompression_data();
+  void extractingWithParallelDecompression();
  protected slots:
   static void defaultErrorHandler(short code);
 };
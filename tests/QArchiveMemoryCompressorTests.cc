@@ -418,6 +418,113 @@ void QArchiveMemoryCompressorTests::compressEmptyFiles() {
   archive->deleteLater();
 }
 
+void QArchiveMemoryCompressorTests::compressingWithParallelFilters_data() {
+  QTest::addColumn<short>("format");
+  QTest::newRow("gzip") << short(QArchive::GZipFormat);
+  QTest::newRow("bzip2") << short(QArchive::BZip2Format);
+}
+
+void QArchiveMemoryCompressorTests::compressingWithParallelFilters() {
+  QFETCH(short, format);
+  QArchive::MemoryCompressor compressor(format);
+  compressor.setThreads(4);
+
+  /* Large enough to be compressed in several chunks. */
+  QByteArray array;
+  while (array.size() < 3 * 1024 * 1024) {
+    array.append(QByteArray::number(array.size()) + ' ');
+  }
+  QBuffer buffer(&array);
+  compressor.addFiles(QFileInfo(Test1OutputFile).fileName(), &buffer);
+
+  QObject::connect(&compressor, &QArchive::MemoryCompressor::error, this,
+                   &QArchiveMemoryCompressorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&compressor, &QArchive::MemoryCompressor::finished);
+  compressor.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait(30000) || spyInfo.count());
+  auto archive = spyInfo.takeFirst().at(0).value<QBuffer*>();
+
+  QArchive::MemoryExtractor extractor(archive);
+  QObject::connect(
+      &extractor, &QArchive::MemoryExtractor::error, this,
+      &QArchiveMemoryCompressorTests::defaultExtractorErrorHandler);
+  QSignalSpy spyExtractor(&extractor, &QArchive::MemoryExtractor::finished);
+  extractor.start();
+
+  QVERIFY(spyExtractor.wait(30000) || spyExtractor.count());
+  auto data = spyExtractor.takeFirst()
+                  .at(0)
+                  .value<QArchive::MemoryExtractorOutput*>();
+
+  /* The concatenated chunks read back as a single stream. */
+  QVERIFY(!data->getFiles().empty());
+  auto outputBuffer = data->getFiles().at(0).buffer();
+  outputBuffer->open(QIODevice::ReadOnly);
+  QVERIFY(outputBuffer->readAll() == array);
+  outputBuffer->close();
+
+  data->deleteLater();
+  archive->deleteLater();
+}
+
+void QArchiveMemoryCompressorTests::compressingZipInParallel() {
+  QArchive::MemoryCompressor compressor(QArchive::ZipFormat);
+  compressor.setThreads(4);
+
+  /* Entries of different sizes, so they are done out of order, and an
+   * empty one which is stored. */
+  std::vector<QByteArray> arrays;
+  for (int i = 0; i < 16; ++i) {
+    QByteArray array;
+    while (array.size() < (i % 4) * 300 * 1000) {
+      array.append(QByteArray::number(array.size() * (i + 1)) + ' ');
+    }
+    arrays.push_back(array);
+  }
+  std::vector<std::unique_ptr<QBuffer>> buffers;
+  for (int i = 0; i < 16; ++i) {
+    buffers.emplace_back(new QBuffer(&arrays[i]));
+    compressor.addFiles(QString("Entry%1.txt").arg(i), buffers.back().get());
+  }
+
+  QObject::connect(&compressor, &QArchive::MemoryCompressor::error, this,
+                   &QArchiveMemoryCompressorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&compressor, &QArchive::MemoryCompressor::finished);
+  compressor.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait(30000) || spyInfo.count());
+  auto archive = spyInfo.takeFirst().at(0).value<QBuffer*>();
+
+  QArchive::MemoryExtractor extractor(archive);
+  QObject::connect(
+      &extractor, &QArchive::MemoryExtractor::error, this,
+      &QArchiveMemoryCompressorTests::defaultExtractorErrorHandler);
+  QSignalSpy spyExtractor(&extractor, &QArchive::MemoryExtractor::finished);
+  extractor.start();
+
+  QVERIFY(spyExtractor.wait(30000) || spyExtractor.count());
+  auto data = spyExtractor.takeFirst()
+                  .at(0)
+                  .value<QArchive::MemoryExtractorOutput*>();
+
+  /* The entries must be written in the order they were added. */
+  QCOMPARE(static_cast<int>(data->getFiles().size()), 16);
+  for (int i = 0; i < 16; ++i) {
+    const auto& file = data->getFiles().at(i);
+    QCOMPARE(file.fileInformation().value("FileName").toString(),
+             QString("Entry%1.txt").arg(i));
+    file.buffer()->open(QIODevice::ReadOnly);
+    QVERIFY(file.buffer()->readAll() == arrays[i]);
+    file.buffer()->close();
+  }
+
+  data->deleteLater();
+  archive->deleteLater();
+}
+
 void QArchiveMemoryCompressorTests::defaultErrorHandler(short code,
                                                         const QString& file) {
   auto scode = QArchive::errorCodeToString(code);
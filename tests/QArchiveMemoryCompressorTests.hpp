@@ -13,6 +13,9 @@
 #include <QTest>
 #include <QTimer>
 
+#include <memory>
+#include <vector>
+
 #include "QArchiveTestCases.hpp"
 
 class QArchiveMemoryCompressorTests : public QObject,
@@ -30,6 +33,9 @@ class QArchiveMemoryCompressorTests : public QObject,
   void compressingTarArchiveWithoutFilters();
   void compressingTarArchiveWithZSTD();
   void compressEmptyFiles();
+  void compressingWithParallelFilters_data();
+  void compressingWithParallelFilters();
+  void compressingZipInParallel();
 
  protected slots:
   static void defaultErrorHandler(short code, const QString& file);
@@ -1,5 +1,47 @@
 #include <QArchiveMemoryExtractorTests.hpp>
 
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <cstring>
+
+namespace {
+/* A device which can only be read through once, like a socket or a pipe. */
+class SequentialDevice : public QIODevice {
+ public:
+  explicit SequentialDevice(QByteArray data) : m_Data(std::move(data)) {}
+
+  bool isSequential() const override { return true; }
+  qint64 bytesAvailable() const override {
+    return m_Data.size() - n_Pos + QIODevice::bytesAvailable();
+  }
+
+ protected:
+  qint64 readData(char* data, qint64 maxSize) override {
+    const qint64 n = qMin<qint64>(maxSize, m_Data.size() - n_Pos);
+    memcpy(data, m_Data.constData() + n_Pos, n);
+    n_Pos += n;
+    return n;
+  }
+  qint64 writeData(const char*, qint64) override { return -1; }
+
+ private:
+  QByteArray m_Data;
+  qint64 n_Pos = 0;
+};
+
+/* A sequential device whose sender stalls once its data is read. */
+class StallingDevice : public SequentialDevice {
+ public:
+  using SequentialDevice::SequentialDevice;
+
+  bool waitForReadyRead(int msecs) override {
+    QThread::msleep(static_cast<unsigned long>(qMax(msecs, 0)));
+    return false;
+  }
+};
+}  // namespace
+
 void QArchiveMemoryExtractorTests::initTestCase() {
   QDir cases(TestCasesDir);
   if (cases.exists()) {
@@ -235,6 +277,162 @@ void QArchiveMemoryExtractorTests::extractArchiveFromQIODevice() {
   delete data;
 }
 
+void QArchiveMemoryExtractorTests::extractArchiveFromQBuffer() {
+  QFile file(TestCase1ArchivePath);
+  QVERIFY(file.open(QIODevice::ReadOnly) == true);
+
+  /* Archives already in memory are read in place. */
+  QBuffer archive;
+  archive.setData(file.readAll());
+  QVERIFY(archive.open(QIODevice::ReadOnly) == true);
+
+  QArchive::MemoryExtractor e(&archive);
+
+  QObject::connect(&e, &QArchive::MemoryExtractor::error, this,
+                   &QArchiveMemoryExtractorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, &QArchive::MemoryExtractor::finished);
+  e.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  QList<QVariant> output = spyInfo.takeFirst();
+  auto data = output.at(0).value<QArchive::MemoryExtractorOutput*>();
+
+  auto buffer = data->getFiles().at(0).sharedBuffer();
+
+  buffer->open(QIODevice::ReadOnly);
+  QCOMPARE(Test1OutputContents, QString(buffer->readAll()));
+  buffer->close();
+
+  /* The archive must be left where it was given. */
+  QCOMPARE(archive.pos(), 0);
+
+  delete data;
+}
+
+void QArchiveMemoryExtractorTests::extractArchiveFromSequentialDevice() {
+  QFile file(TestCase6ArchivePath);
+  QVERIFY(file.open(QIODevice::ReadOnly) == true);
+
+  /* Tar archives can be streamed, so they need no seeking. */
+  SequentialDevice archive(file.readAll());
+  QVERIFY(archive.open(QIODevice::ReadOnly) == true);
+
+  QArchive::MemoryExtractor e(&archive);
+  e.setCalculateProgress(true);
+
+  QObject::connect(&e, &QArchive::MemoryExtractor::error, this,
+                   &QArchiveMemoryExtractorTests::defaultErrorHandler);
+  QSignalSpy spyInfo(&e, &QArchive::MemoryExtractor::finished);
+  e.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  QList<QVariant> output = spyInfo.takeFirst();
+  auto data = output.at(0).value<QArchive::MemoryExtractorOutput*>();
+
+  auto buffer = data->getFiles().at(0).sharedBuffer();
+
+  buffer->open(QIODevice::ReadOnly);
+  QCOMPARE(Test6OutputContents, QString(buffer->readAll()));
+  buffer->close();
+
+  delete data;
+}
+
+void QArchiveMemoryExtractorTests::sequentialReadTimeout() {
+  QFile file(TestCase6ArchivePath);
+  QVERIFY(file.open(QIODevice::ReadOnly) == true);
+
+  /* Only the header of the entry ever arrives. */
+  StallingDevice archive(file.read(512));
+  QVERIFY(archive.open(QIODevice::ReadOnly) == true);
+
+  QArchive::MemoryExtractor e(&archive);
+  e.setSequentialTimeout(200);
+  QSignalSpy spyError(&e, &QArchive::MemoryExtractor::error);
+  QSignalSpy spyFinished(&e, &QArchive::MemoryExtractor::finished);
+
+  QElapsedTimer timer;
+  timer.start();
+  e.start();
+
+  /* The read fails after the timeout instead of the default 30 seconds. */
+  QVERIFY(spyError.wait(10000) || spyError.count());
+  QVERIFY(timer.elapsed() < 10000);
+  QCOMPARE(spyError.takeFirst().at(0).toInt(),
+           int(QArchive::ArchiveReadTimeout));
+  QCOMPARE(spyFinished.count(), 0);
+}
+
+void QArchiveMemoryExtractorTests::sequentialReadTimeoutAtEntryBoundary() {
+  QFile file(TestCase6ArchivePath);
+  QVERIFY(file.open(QIODevice::ReadOnly) == true);
+  const QByteArray contents = file.readAll();
+
+  /* The sender stalls right after the data of the first entry, where the
+   * next header or the end of the archive would start. Taking that as the
+   * end would extract the archive as if it were complete. */
+  const qint64 size = contents.mid(124, 11).toLongLong(nullptr, 8);
+  StallingDevice archive(contents.left(512 + (size + 511) / 512 * 512));
+  QVERIFY(archive.open(QIODevice::ReadOnly) == true);
+
+  QArchive::MemoryExtractor e(&archive);
+  e.setSequentialTimeout(200);
+  QSignalSpy spyError(&e, &QArchive::MemoryExtractor::error);
+  QSignalSpy spyFinished(&e, &QArchive::MemoryExtractor::finished);
+  e.start();
+
+  QVERIFY(spyError.wait(10000) || spyError.count());
+  QCOMPARE(spyError.takeFirst().at(0).toInt(),
+           int(QArchive::ArchiveReadTimeout));
+  QCOMPARE(spyFinished.count(), 0);
+}
+
+void QArchiveMemoryExtractorTests::cancelingSequentialRead() {
+  QFile file(TestCase6ArchivePath);
+  QVERIFY(file.open(QIODevice::ReadOnly) == true);
+
+  StallingDevice archive(file.read(512));
+  QVERIFY(archive.open(QIODevice::ReadOnly) == true);
+
+  /* The wait blocks the thread of the extractor, so it needs its own. */
+  QArchive::MemoryExtractor e(&archive, nullptr, /*singleThreaded=*/false);
+  e.setSequentialTimeout(-1);
+  QSignalSpy spyStarted(&e, &QArchive::MemoryExtractor::started);
+  QSignalSpy spyCanceled(&e, &QArchive::MemoryExtractor::canceled);
+  e.start();
+  QVERIFY(spyStarted.wait() || spyStarted.count());
+
+  QElapsedTimer timer;
+  timer.start();
+  e.cancel();
+  QVERIFY(spyCanceled.wait(10000) || spyCanceled.count());
+  QVERIFY(timer.elapsed() < 10000);
+}
+
+void QArchiveMemoryExtractorTests::startAfterInfoFromSequentialDevice() {
+  QFile file(TestCase6ArchivePath);
+  QVERIFY(file.open(QIODevice::ReadOnly) == true);
+
+  SequentialDevice archive(file.readAll());
+  QVERIFY(archive.open(QIODevice::ReadOnly) == true);
+
+  QArchive::MemoryExtractor e(&archive);
+  QSignalSpy spyInfo(&e, SIGNAL(info(QJsonObject)));
+  e.getInfo();
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  /* getInfo() read the archive through, nothing is left to extract. */
+  QSignalSpy spyError(&e, &QArchive::MemoryExtractor::error);
+  e.start();
+  QVERIFY(spyError.wait() || spyError.count());
+  QCOMPARE(spyError.takeFirst().at(0).toInt(),
+           static_cast<int>(QArchive::IODeviceSequential));
+}
+
 /* Sometimes , if the skip callback is not proper , the getInfo will not
  * work for tar archives so we need to test it everytime. */
 void QArchiveMemoryExtractorTests::getInfoFromTarArchiveWithNoFilters() {
@@ -330,6 +528,146 @@ void QArchiveMemoryExtractorTests::testProgress() {
   QCOMPARE(progressSpyInfo.count(), 4);
 }
 
+void QArchiveMemoryExtractorTests::preallocatedEntryBuffers() {
+  QArchive::MemoryExtractor e(TestCase1ArchivePath);
+  e.setBlockSize(4);
+  QObject::connect(&e, &QArchive::MemoryExtractor::error, this,
+                   &QArchiveMemoryExtractorTests::defaultErrorHandler);
+
+  QSignalSpy spyInfo(&e, &QArchive::MemoryExtractor::finished);
+  e.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  QList<QVariant> output = spyInfo.takeFirst();
+  auto data = output.at(0).value<QArchive::MemoryExtractorOutput*>();
+
+  auto buffer = data->getFiles().at(0).sharedBuffer();
+
+  /* The buffer is allocated once from the size in the header, so written
+   * in many blocks it must still have the capacity reserved for that size
+   * instead of one it grew to. */
+  QByteArray reserved;
+  reserved.reserve(Test1OutputContents.size());
+  QCOMPARE(buffer->buffer().size(), Test1OutputContents.size());
+  QCOMPARE(buffer->buffer().capacity(), reserved.capacity());
+
+  buffer->open(QIODevice::ReadOnly);
+  QCOMPARE(Test1OutputContents, QString(buffer->readAll()));
+  buffer->close();
+
+  delete data;
+}
+
+void QArchiveMemoryExtractorTests::streamingToEntryDevices() {
+  QArchive::MemoryExtractor e(TestCase1ArchivePath);
+  e.setBlockSize(4);
+  QObject::connect(&e, &QArchive::MemoryExtractor::error, this,
+                   &QArchiveMemoryExtractorTests::defaultErrorHandler);
+
+  QBuffer device;
+  QString entryName;
+  e.setEntryDeviceFactory([&](const QJsonObject& info) -> QIODevice* {
+    entryName = info.value("FileName").toString();
+    return &device;
+  });
+
+  QSignalSpy spyInfo(&e, &QArchive::MemoryExtractor::finished);
+  e.start();
+
+  /*  Must emit exactly one signal. */
+  QVERIFY(spyInfo.wait() || spyInfo.count());
+
+  QList<QVariant> output = spyInfo.takeFirst();
+  auto data = output.at(0).value<QArchive::MemoryExtractorOutput*>();
+
+  /* Streamed entries are not kept in the output. */
+  QVERIFY(data->getFiles().isEmpty());
+  QVERIFY(!entryName.isEmpty());
+  QVERIFY(!device.isOpen());
+  QCOMPARE(Test1OutputContents, QString(device.data()));
+
+  delete data;
+}
+
+void QArchiveMemoryExtractorTests::benchmarkLargeEntry() {
+  QARCHIVE_SKIP_UNLESS_BENCHMARKING();
+
+  /* A single entry extracted to memory in many blocks. */
+  const int inputSize = 64 * 1024 * 1024;
+  const QString inputPath = TestOutputDir + "LargeEntry.txt";
+  const QString archivePath = TestOutputDir + "LargeEntry.tar";
+  {
+    QFile input(inputPath);
+    QVERIFY(input.open(QIODevice::WriteOnly) == true);
+    const QByteArray line("QArchive extracts to memory in blocks.\n");
+    for (int written = 0; written < inputSize; written += line.size()) {
+      input.write(line);
+    }
+  }
+  QArchive::DiskCompressor c(archivePath, QArchive::TarFormat);
+  c.addFiles(QFileInfo(inputPath).fileName(), inputPath);
+  QSignalSpy compressorSpy(&c, SIGNAL(finished()));
+  c.start();
+  QVERIFY(compressorSpy.wait(600000) || compressorSpy.count());
+
+  QBENCHMARK {
+    QArchive::MemoryExtractor e(archivePath);
+    QObject::connect(&e, &QArchive::MemoryExtractor::error, this,
+                     &QArchiveMemoryExtractorTests::defaultErrorHandler);
+    QSignalSpy spyInfo(&e, &QArchive::MemoryExtractor::finished);
+    e.start();
+    QVERIFY(spyInfo.wait(600000) || spyInfo.count());
+    delete spyInfo.takeFirst().at(0).value<QArchive::MemoryExtractorOutput*>();
+  }
+  QFile::remove(inputPath);
+  QFile::remove(archivePath);
+}
+
+void QArchiveMemoryExtractorTests::benchmarkSmallArchives_data() {
+  QTest::addColumn<bool>("dropPageCache");
+  QTest::newRow("mapped") << false;
+  QTest::newRow("read") << true;
+}
+
+void QArchiveMemoryExtractorTests::benchmarkSmallArchives() {
+  QARCHIVE_SKIP_UNLESS_BENCHMARKING();
+  QFETCH(bool, dropPageCache);
+
+  /* The archive is well below 1 KiB, so opening it is what is measured. A
+   * mapped file is read in place, one read through the device needs a read
+   * buffer of a whole block. */
+  QFile file(TestCase1ArchivePath);
+  QVERIFY(file.open(QIODevice::ReadOnly) == true);
+  QVERIFY(file.size() <= 1024);
+
+  int archives = 0;
+  QElapsedTimer timer;
+  timer.start();
+  QBENCHMARK {
+    QArchive::MemoryExtractor e(&file);
+    e.setDropPageCache(dropPageCache);
+    QObject::connect(&e, &QArchive::MemoryExtractor::error, this,
+                     &QArchiveMemoryExtractorTests::defaultErrorHandler);
+    QSignalSpy statisticsSpy(&e, &QArchive::MemoryExtractor::statistics);
+    QSignalSpy spyInfo(&e, &QArchive::MemoryExtractor::finished);
+    e.start();
+    QVERIFY(spyInfo.wait() || spyInfo.count());
+    delete spyInfo.takeFirst().at(0).value<QArchive::MemoryExtractorOutput*>();
+    QCOMPARE(statisticsSpy.count(), 1);
+    QCOMPARE(statisticsSpy.takeFirst()
+                 .at(0)
+                 .toJsonObject()
+                 .value("MemoryBacked")
+                 .toBool(),
+             !dropPageCache);
+    ++archives;
+  }
+  qInfo("%.0f archives/s",
+        archives * 1000.0 / qMax<qint64>(timer.elapsed(), 1));
+}
+
 void QArchiveMemoryExtractorTests::cleanupTestCase() {
   QDir dir(TestOutputDir);
   dir.removeRecursively();
@@ -26,10 +26,21 @@ class QArchiveMemoryExtractorTests : public QObject, private QArchiveTestCases {
   static void testInvalidArchivePath();
   void runningExtractorNonSingleThreaded();
   void extractArchiveFromQIODevice();
+  void extractArchiveFromQBuffer();
+  void extractArchiveFromSequentialDevice();
+  void sequentialReadTimeout();
+  void sequentialReadTimeoutAtEntryBoundary();
+  void cancelingSequentialRead();
+  void startAfterInfoFromSequentialDevice();
   void getInfoFromTarArchiveWithNoFilters();
   void extractTarArchiveWithNoFilters();
   void isExtractorObjectReuseable();
   void testProgress();
+  void preallocatedEntryBuffers();
+  void streamingToEntryDevices();
+  void benchmarkLargeEntry();
+  void benchmarkSmallArchives_data();
+  void benchmarkSmallArchives();
   void cleanupTestCase();
  protected slots:
   static void defaultErrorHandler(short code);
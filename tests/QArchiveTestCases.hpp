@@ -2,6 +2,25 @@
 #define QARCHIVE_TEST_CASES_HPP_INCLUDED
 #include <QString>
 #include <QTemporaryDir>
+#include <QtGlobal>
+
+/*
+ * Benchmarks take a long time and a lot of disk space, so they are
+ * skipped unless QARCHIVE_BENCHMARKS is set in the environment.
+*/
+#define QARCHIVE_SKIP_UNLESS_BENCHMARKING()                        \
+  if (qEnvironmentVariableIsEmpty("QARCHIVE_BENCHMARKS")) {        \
+    QSKIP("Set QARCHIVE_BENCHMARKS to run the benchmarks.");       \
+  }
+
+/*
+ * So are the tests which need archives of more than 4 GiB or with tens of
+ * thousands of entries, unless QARCHIVE_LARGE_TESTS is set.
+*/
+#define QARCHIVE_SKIP_UNLESS_LARGE_TESTS()                         \
+  if (qEnvironmentVariableIsEmpty("QARCHIVE_LARGE_TESTS")) {       \
+    QSKIP("Set QARCHIVE_LARGE_TESTS to run the large tests.");     \
+  }
 
 /*
  * Abstract class to hold the test case information.